@@ -0,0 +1,107 @@
+// MIT License (see file: LICENSE)
+
+#include "allocatorMagazine.h"
+
+static inline void lockShared(AllocatorMagazine* magazine) {
+    if (magazine->m_lock)
+        lockSpinLock(magazine->m_lock);
+}
+
+static inline void unlockShared(AllocatorMagazine* magazine) {
+    if (magazine->m_lock)
+        unlockSpinLock(magazine->m_lock);
+}
+
+// Hands cached allocations back until at most keepCount remain in the bin.
+// Caller holds the shared lock.
+static void spillMagazineBin(AllocatorMagazine* magazine,
+                             MagazineBin* bin,
+                             const uint32 keepCount) {
+    if (bin->count <= keepCount)
+        return;
+    freeBatch(magazine->m_allocator, &bin->allocations[keepCount],
+              bin->count - keepCount);
+    bin->count = keepCount;
+}
+
+void initAllocatorMagazine(AllocatorMagazine* magazine,
+                           Allocator* allocator,
+                           SpinLock* lock) {
+    magazine->m_allocator = allocator;
+    magazine->m_lock = lock;
+    for (uint32 i = 0; i < MAGAZINE_NUM_BINS; i++) {
+        magazine->m_bins[i].count = 0;
+    }
+}
+
+void flushAllocatorMagazine(AllocatorMagazine* magazine) {
+    lockShared(magazine);
+    for (uint32 i = 0; i < MAGAZINE_NUM_BINS; i++) {
+        spillMagazineBin(magazine, &magazine->m_bins[i], 0);
+    }
+    unlockShared(magazine);
+}
+
+Allocation magazineAllocate(AllocatorMagazine* magazine,
+                            const OffsetType size) {
+    uint32 binIndex = uintToFloatRoundUp(size);
+
+    // Not a cached size class: straight to the shared allocator
+    if (binIndex < MAGAZINE_MIN_BIN || binIndex > MAGAZINE_MAX_BIN) {
+        lockShared(magazine);
+        Allocation res = allocate(magazine->m_allocator, size);
+        unlockShared(magazine);
+        return res;
+    }
+
+    MagazineBin* bin = &magazine->m_bins[binIndex - MAGAZINE_MIN_BIN];
+
+    // Empty? Refill a batch of full bin sized allocations under one lock
+    if (bin->count == 0) {
+        OffsetType sizes[MAGAZINE_BATCH];
+        for (uint32 i = 0; i < MAGAZINE_BATCH; i++) {
+            sizes[i] = floatToUint(binIndex);
+        }
+
+        Allocation batch[MAGAZINE_BATCH];
+        lockShared(magazine);
+        allocateBatch(magazine->m_allocator, sizes, MAGAZINE_BATCH, batch);
+        unlockShared(magazine);
+
+        for (uint32 i = 0; i < MAGAZINE_BATCH; i++) {
+            if (batch[i].offset != NO_SPACE)
+                bin->allocations[bin->count++] = batch[i];
+        }
+
+        if (bin->count == 0) {
+            Allocation res = EmptyAllocation;
+            return res;
+        }
+    }
+
+    return bin->allocations[--bin->count];
+}
+
+void magazineFree(AllocatorMagazine* magazine, Allocation allocation) {
+    // The size lookup reads the shared node arrays, which other threads may
+    // reallocate (growAllocator) or write: lock once for the whole free
+    lockShared(magazine);
+    OffsetType size = allocationSize(magazine->m_allocator, allocation);
+    uint32 binIndex = uintToFloatRoundDown(size);
+
+    // Only exact bin sized allocations can be handed out again from the cache
+    if (binIndex < MAGAZINE_MIN_BIN || binIndex > MAGAZINE_MAX_BIN ||
+        floatToUint(binIndex) != size) {
+        freeAllocation(magazine->m_allocator, allocation);
+        unlockShared(magazine);
+        return;
+    }
+
+    // Full? Spill a batch back to the shared allocator
+    MagazineBin* bin = &magazine->m_bins[binIndex - MAGAZINE_MIN_BIN];
+    if (bin->count == MAGAZINE_CAPACITY)
+        spillMagazineBin(magazine, bin, MAGAZINE_CAPACITY - MAGAZINE_BATCH);
+    unlockShared(magazine);
+
+    bin->allocations[bin->count++] = allocation;
+}
@@ -0,0 +1,47 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocator.h"
+#include "spinLock.h"
+
+// Per-thread allocation cache (magazine) for the hot small size classes.
+//
+// Each thread owns one AllocatorMagazine. Allocations whose round-up bin is
+// in [MAGAZINE_MIN_BIN, MAGAZINE_MAX_BIN] are served from a small per-bin
+// stack of cached allocations, and only go to the shared allocator (under its
+// lock) in batches of MAGAZINE_BATCH when the stack runs empty or overflows.
+// Frees still take the lock briefly: the size lookup reads the shared nodes.
+// Cached allocations are always exactly floatToUint(bin) elements, so a hit
+// may return up to one bin step (12.5%) more than requested.
+//
+// Cached allocations still count as used in the shared allocator. Call
+// flushAllocatorMagazine() to hand them back before trusting storageReport().
+
+#define MAGAZINE_MIN_BIN 8
+#define MAGAZINE_MAX_BIN 64
+#define MAGAZINE_NUM_BINS (MAGAZINE_MAX_BIN - MAGAZINE_MIN_BIN + 1)
+#define MAGAZINE_CAPACITY 32
+#define MAGAZINE_BATCH 16
+
+typedef struct {
+    uint32 count;
+    Allocation allocations[MAGAZINE_CAPACITY];
+} MagazineBin;
+
+typedef struct {
+    Allocator* m_allocator;
+    SpinLock* m_lock;  // Optional: NULL when the allocator isn't shared
+    MagazineBin m_bins[MAGAZINE_NUM_BINS];
+} AllocatorMagazine;
+
+void initAllocatorMagazine(AllocatorMagazine* magazine,
+                           Allocator* allocator,
+                           SpinLock* lock);
+
+// Returns all cached allocations to the shared allocator
+void flushAllocatorMagazine(AllocatorMagazine* magazine);
+
+Allocation magazineAllocate(AllocatorMagazine* magazine,
+                            const OffsetType size);
+
+void magazineFree(AllocatorMagazine* magazine, Allocation allocation);
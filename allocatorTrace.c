@@ -0,0 +1,334 @@
+// MIT License (see file: LICENSE)
+
+#include "allocatorTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL _Thread_local
+#endif
+
+// Chunk header is encoded in front of the events, so that a chunk is written
+// with one fwrite (fwrite locks the stream, chunks never interleave)
+#define TRACE_HEADER_RESERVE 32
+#define TRACE_MAX_EVENT_BYTES 64
+
+typedef struct TraceBuffer {
+    struct TraceBuffer* next;  // Registry of all thread buffers
+    uint32 thread;
+    uint32 used;
+    uint64 firstSequence;
+    uint64 lastSequence;
+    uint8 bytes[TRACE_HEADER_RESERVE + TRACE_BUFFER_SIZE];
+} TraceBuffer;
+
+// Buffers are kept for the process lifetime (a trace may be restarted), so
+// the thread local pointers never dangle
+static FILE* traceFile = NULL;
+static volatile long traceActive = 0;
+static volatile long long traceSequence = 0;
+static volatile long traceThreadCount = 0;
+static TraceBuffer* volatile traceBuffers = NULL;
+static TRACE_THREAD_LOCAL TraceBuffer* threadBuffer = NULL;
+
+static inline uint64 atomicFetchAdd64(volatile long long* target) {
+#ifdef _MSC_VER
+    return (uint64)_InterlockedExchangeAdd64(target, 1);
+#else
+    return (uint64)__atomic_fetch_add(target, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline uint32 atomicFetchAdd(volatile long* target) {
+#ifdef _MSC_VER
+    return (uint32)_InterlockedExchangeAdd(target, 1);
+#else
+    return (uint32)__atomic_fetch_add(target, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void registerBuffer(TraceBuffer* buffer) {
+#ifdef _MSC_VER
+    TraceBuffer* head;
+    do {
+        head = traceBuffers;
+        buffer->next = head;
+    } while (_InterlockedCompareExchangePointer(
+                 (void* volatile*)&traceBuffers, buffer, head) != head);
+#else
+    TraceBuffer* head = __atomic_load_n(&traceBuffers, __ATOMIC_RELAXED);
+    do {
+        buffer->next = head;
+    } while (!__atomic_compare_exchange_n(&traceBuffers, &head, buffer, true,
+                                          __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+#endif
+}
+
+static inline uint8* writeVarint(uint8* out, uint64 value) {
+    while (value >= 0x80) {
+        *out++ = (uint8)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8)value;
+    return out;
+}
+
+static inline bool readVarint(const uint8** in,
+                              const uint8* end,
+                              uint64* value) {
+    uint64 result = 0;
+    for (uint32 shift = 0; shift < 64; shift += 7) {
+        if (*in == end)
+            return false;
+        uint8 byte = *(*in)++;
+        result |= (uint64)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void flushBuffer(TraceBuffer* buffer) {
+    if (buffer->used == 0)
+        return;
+
+    uint8 header[TRACE_HEADER_RESERVE];
+    uint8* end = writeVarint(header, buffer->thread);
+    end = writeVarint(end, buffer->firstSequence);
+    end = writeVarint(end, buffer->used);
+    uint32 headerSize = (uint32)(end - header);
+
+    uint8* chunk = &buffer->bytes[TRACE_HEADER_RESERVE - headerSize];
+    memcpy(chunk, header, headerSize);
+    if (traceFile)
+        fwrite(chunk, 1, headerSize + buffer->used, traceFile);
+    buffer->used = 0;
+}
+
+static void appendEvent(const TraceEventType type,
+                        const uint32 id,
+                        const uint64* fields,
+                        const uint32 fieldCount) {
+    if (!traceActive || id == 0)
+        return;
+
+    TraceBuffer* buffer = threadBuffer;
+    if (!buffer) {
+        buffer = (TraceBuffer*)malloc(sizeof(TraceBuffer));
+        if (!buffer)
+            return;
+        buffer->thread = atomicFetchAdd(&traceThreadCount);
+        buffer->used = 0;
+        registerBuffer(buffer);
+        threadBuffer = buffer;
+    }
+
+    if (buffer->used + TRACE_MAX_EVENT_BYTES > TRACE_BUFFER_SIZE)
+        flushBuffer(buffer);
+
+    uint64 sequence = atomicFetchAdd64(&traceSequence);
+    if (buffer->used == 0) {
+        buffer->firstSequence = sequence;
+        buffer->lastSequence = sequence;
+    }
+
+    uint8* start = &buffer->bytes[TRACE_HEADER_RESERVE + buffer->used];
+    uint8* out = start;
+    *out++ = (uint8)type;
+    out = writeVarint(out, sequence - buffer->lastSequence);
+    out = writeVarint(out, id);
+    for (uint32 i = 0; i < fieldCount; i++) {
+        out = writeVarint(out, fields[i]);
+    }
+    buffer->lastSequence = sequence;
+    buffer->used += (uint32)(out - start);
+}
+
+bool startAllocatorTrace(const char* path) {
+    if (traceFile)
+        return false;
+    traceFile = fopen(path, "wb");
+    if (!traceFile)
+        return false;
+
+    uint32 header[2] = {TRACE_FILE_MAGIC, TRACE_FILE_VERSION};
+    fwrite(header, sizeof(header), 1, traceFile);
+    traceSequence = 0;
+    traceActive = 1;
+    return true;
+}
+
+void stopAllocatorTrace(void) {
+    if (!traceFile)
+        return;
+    traceActive = 0;
+    for (TraceBuffer* buffer = traceBuffers; buffer; buffer = buffer->next) {
+        flushBuffer(buffer);
+    }
+    fclose(traceFile);
+    traceFile = NULL;
+}
+
+void flushAllocatorTrace(void) {
+    if (threadBuffer && traceActive)
+        flushBuffer(threadBuffer);
+}
+
+#ifdef USE_ALLOCATOR_TRACE
+void traceAllocator(Allocator* allocator, const uint32 id) {
+    allocator->m_traceId = id;
+    uint64 fields[3] = {allocator->m_size, allocator->m_maxAllocs,
+                        (uint64)allocator->m_policy};
+    appendEvent(TRACE_EVENT_INIT, id, fields, 3);
+}
+#endif
+
+void traceEventAllocate(const uint32 id,
+                        const OffsetType size,
+                        const OffsetType alignment,
+                        const Allocation allocation) {
+    uint64 metadata =
+        allocation.offset == NO_SPACE ? 0 : (uint64)allocation.metadata + 1;
+    uint64 fields[3] = {size, alignment, metadata};
+    appendEvent(TRACE_EVENT_ALLOCATE, id, fields, 3);
+}
+
+void traceEventAllocateTransient(const uint32 id,
+                                 const OffsetType size,
+                                 const Allocation allocation) {
+    uint64 metadata =
+        allocation.offset == NO_SPACE ? 0 : (uint64)allocation.metadata + 1;
+    uint64 fields[3] = {size, 1, metadata};
+    appendEvent(TRACE_EVENT_ALLOCATE_TRANSIENT, id, fields, 3);
+}
+
+void traceEventReallocate(const uint32 id,
+                          const uint32 nodeIndex,
+                          const OffsetType newSize,
+                          const Allocation allocation,
+                          const ReallocateResult result) {
+    uint64 metadata =
+        result == REALLOCATE_FAILED ? 0 : (uint64)allocation.metadata + 1;
+    uint64 fields[3] = {nodeIndex, newSize, metadata};
+    appendEvent(TRACE_EVENT_REALLOCATE, id, fields, 3);
+}
+
+void traceEventFree(const uint32 id, const uint32 nodeIndex) {
+    uint64 fields[1] = {nodeIndex};
+    appendEvent(TRACE_EVENT_FREE, id, fields, 1);
+}
+
+void traceEventReset(const uint32 id) {
+    appendEvent(TRACE_EVENT_RESET, id, NULL, 0);
+}
+
+void traceEventGrow(const uint32 id,
+                    const OffsetType size,
+                    const uint32 max_allocs) {
+    uint64 fields[2] = {size, max_allocs};
+    appendEvent(TRACE_EVENT_GROW, id, fields, 2);
+}
+
+// Decoding...
+static bool decodeEvent(const uint8** in,
+                        const uint8* end,
+                        TraceEvent* event) {
+    if (*in == end)
+        return false;
+    uint8 type = *(*in)++;
+
+    uint64 delta, id;
+    if (!readVarint(in, end, &delta) || !readVarint(in, end, &id))
+        return false;
+
+    uint32 fieldCounts[] = {3, 3, 1, 0, 2, 3, 3};
+    if (type > TRACE_EVENT_REALLOCATE)
+        return false;
+    uint64 fields[3] = {0, 0, 0};
+    for (uint32 i = 0; i < fieldCounts[type]; i++) {
+        if (!readVarint(in, end, &fields[i]))
+            return false;
+    }
+
+    memset(event, 0, sizeof(TraceEvent));
+    event->sequence = delta;  // Caller adds the previous sequence
+    event->type = (TraceEventType)type;
+    event->allocatorId = (uint32)id;
+    event->metadata = TRACE_NO_METADATA;
+    event->newMetadata = TRACE_NO_METADATA;
+    switch (event->type) {
+    case TRACE_EVENT_INIT:
+        event->size = fields[0];
+        event->maxAllocs = (uint32)fields[1];
+        event->policy = (uint32)fields[2];
+        break;
+    case TRACE_EVENT_ALLOCATE:
+    case TRACE_EVENT_ALLOCATE_TRANSIENT:
+        event->size = fields[0];
+        event->alignment = fields[1];
+        if (fields[2])
+            event->metadata = (uint32)(fields[2] - 1);
+        break;
+    case TRACE_EVENT_FREE:
+        event->metadata = (uint32)fields[0];
+        break;
+    case TRACE_EVENT_REALLOCATE:
+        event->metadata = (uint32)fields[0];
+        event->size = fields[1];
+        if (fields[2])
+            event->newMetadata = (uint32)(fields[2] - 1);
+        break;
+    case TRACE_EVENT_GROW:
+        event->size = fields[0];
+        event->maxAllocs = (uint32)fields[1];
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+uint64 decodeAllocatorTrace(const void* data,
+                            const uint64 size,
+                            TraceEvent* events,
+                            const uint64 maxEvents) {
+    uint32 header[2];
+    if (size < sizeof(header))
+        return 0;
+    memcpy(header, data, sizeof(header));
+    if (header[0] != TRACE_FILE_MAGIC || header[1] != TRACE_FILE_VERSION)
+        return 0;
+
+    const uint8* in = (const uint8*)data + sizeof(header);
+    const uint8* end = (const uint8*)data + size;
+    uint64 count = 0;
+    while (in < end) {
+        uint64 thread, sequence, chunkSize;
+        if (!readVarint(&in, end, &thread) ||
+            !readVarint(&in, end, &sequence) ||
+            !readVarint(&in, end, &chunkSize) ||
+            chunkSize > (uint64)(end - in)) {
+            break;  // Truncated: keep what was decoded
+        }
+
+        const uint8* chunkEnd = in + chunkSize;
+        TraceEvent event;
+        while (in < chunkEnd && decodeEvent(&in, chunkEnd, &event)) {
+            sequence += event.sequence;
+            event.sequence = sequence;
+            event.thread = (uint32)thread;
+            if (events && count < maxEvents)
+                events[count] = event;
+            count++;
+        }
+        in = chunkEnd;
+    }
+    return events && count > maxEvents ? maxEvents : count;
+}
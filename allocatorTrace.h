@@ -0,0 +1,101 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocator.h"
+
+// Binary allocation trace, for replaying field workloads offline (see
+// tools/traceReplay.c).
+//
+// Compile the library with USE_ALLOCATOR_TRACE, call startAllocatorTrace()
+// and register each allocator with traceAllocator() right after its init.
+// Allocations (also failed ones), reallocations, frees, resets and grows of
+// registered allocators are then appended to a per-thread buffer without locks. A
+// global sequence number orders the events of all threads. Full buffers go
+// to the file as one chunk with a single fwrite.
+//
+// Not traced: setAllocatorPolicy() after registration, defragmentStep() and
+// snapshot loads. Batch allocations are traced as single allocations. A
+// reallocate() is one event whether it stays in place or moves.
+//
+// File: "OATR" magic and version (2 x native uint32), then chunks.
+// Chunk: varint thread, varint first sequence number, varint byte count,
+// then the events. Event: type byte, varint sequence delta to the previous
+// event in the chunk, varint allocator id, then per type:
+//   TRACE_EVENT_INIT:     size, max allocs, policy
+//   TRACE_EVENT_ALLOCATE: size, alignment, metadata + 1 (0 = failed)
+//   TRACE_EVENT_FREE:     metadata
+//   TRACE_EVENT_RESET:    -
+//   TRACE_EVENT_GROW:     size, max allocs
+//   TRACE_EVENT_ALLOCATE_TRANSIENT: as ALLOCATE (allocateWithHint())
+//   TRACE_EVENT_REALLOCATE: metadata, new size, new metadata + 1 (0 = failed)
+
+#define TRACE_FILE_MAGIC 0x5254414f  // "OATR"
+#define TRACE_FILE_VERSION 1
+#define TRACE_BUFFER_SIZE (64 * 1024)
+#define TRACE_NO_METADATA 0xffffffff
+
+typedef enum {
+    TRACE_EVENT_INIT,
+    TRACE_EVENT_ALLOCATE,
+    TRACE_EVENT_FREE,
+    TRACE_EVENT_RESET,
+    TRACE_EVENT_GROW,
+    TRACE_EVENT_ALLOCATE_TRANSIENT,
+    TRACE_EVENT_REALLOCATE,
+} TraceEventType;
+
+typedef struct {
+    uint64 sequence;
+    TraceEventType type;
+    uint32 thread;
+    uint32 allocatorId;
+    uint64 size;          // INIT, ALLOCATE*, REALLOCATE, GROW
+    uint64 alignment;     // ALLOCATE*
+    uint32 metadata;      // ALLOCATE* (TRACE_NO_METADATA = failed), FREE,
+                          // REALLOCATE
+    uint32 newMetadata;   // REALLOCATE (TRACE_NO_METADATA = failed)
+    uint32 maxAllocs;     // INIT, GROW
+    uint32 policy;        // INIT
+} TraceEvent;
+
+// Returns false if the file can't be created or a trace is running
+bool startAllocatorTrace(const char* path);
+
+// Flushes every thread's buffer and closes the file. Other threads must have
+// stopped allocating.
+void stopAllocatorTrace(void);
+
+// Flushes the calling thread's buffer (e.g. before the thread exits)
+void flushAllocatorTrace(void);
+
+#ifdef USE_ALLOCATOR_TRACE
+// Starts tracing an allocator under id (!= 0). 0 stops.
+void traceAllocator(Allocator* allocator, const uint32 id);
+#endif
+
+// Hooks called by the allocator
+void traceEventAllocate(const uint32 id,
+                        const OffsetType size,
+                        const OffsetType alignment,
+                        const Allocation allocation);
+void traceEventAllocateTransient(const uint32 id,
+                                 const OffsetType size,
+                                 const Allocation allocation);
+void traceEventReallocate(const uint32 id,
+                          const uint32 nodeIndex,
+                          const OffsetType newSize,
+                          const Allocation allocation,
+                          const ReallocateResult result);
+void traceEventFree(const uint32 id, const uint32 nodeIndex);
+void traceEventReset(const uint32 id);
+void traceEventGrow(const uint32 id,
+                    const OffsetType size,
+                    const uint32 max_allocs);
+
+// Decodes a whole trace file in memory. Events stay in chunk order, sort by
+// sequence to replay. Returns the event count (events may be NULL to only
+// count), or 0 on a bad header.
+uint64 decodeAllocatorTrace(const void* data,
+                            const uint64 size,
+                            TraceEvent* events,
+                            const uint64 maxEvents);
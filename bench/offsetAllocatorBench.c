@@ -0,0 +1,556 @@
+// MIT License (see file: LICENSE)
+
+// Benchmark suite for the offset allocator hot path.
+//
+// Build (same configuration macros as the library):
+//   cc -std=c11 -O2 -o bench bench/offsetAllocatorBench.c *.c
+// Compare bin resolutions by building with e.g. -DMANTISSA_BITS=5 and running
+// with --baseline against the results of the default build.
+//
+// Add -mavx2 (or build for a NEON target) for the vectorized batch bin
+// computation measured by the bin_index section.
+//
+// Usage:
+//   bench [--filter name] [--ops N] [--curves] [--trace file] [--best-fit]
+//         [--out results.txt] [--baseline results.txt] [--threshold pct]
+//
+// Every workload is pre-generated into an op stream (so that RNG cost is not
+// measured) and then replayed twice: once untimed per op for throughput, and
+// once timing every op for the latency percentiles. --out writes the results
+// in a simple "name ns/op p99" format, --baseline compares against such a
+// file and exits with 1 if any ns/op regressed more than --threshold percent.
+//
+// Trace files are text, one op per line: "a <slot> <size>" allocates into a
+// slot, "f <slot>" frees it.
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "../offsetAllocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static inline uint64 nowNs(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64)(counter.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000ull + (uint64)ts.tv_nsec;
+#endif
+}
+
+// Deterministic xorshift RNG, same stream on every platform
+static uint64 rngState = 0x9E3779B97F4A7C15ull;
+
+static inline uint32 rngNext(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (uint32)(rngState >> 32);
+}
+
+static inline double rngUnit(void) {
+    return (rngNext() + 0.5) / 4294967296.0;
+}
+
+// Op stream
+typedef enum { OP_ALLOCATE, OP_FREE } OpType;
+
+typedef struct {
+    uint32 type;
+    uint32 slot;
+    OffsetType size;
+} Op;
+
+typedef struct {
+    Op* ops;
+    uint32 count;
+    uint32 capacity;
+    uint32 numSlots;
+} OpStream;
+
+static void pushOp(OpStream* stream, OpType type, uint32 slot, OffsetType size) {
+    if (stream->count == stream->capacity) {
+        stream->capacity = stream->capacity ? stream->capacity * 2 : 1024;
+        stream->ops = (Op*)realloc(stream->ops, stream->capacity * sizeof(Op));
+    }
+    Op op = {.type = type, .slot = slot, .size = size};
+    stream->ops[stream->count++] = op;
+    if (slot >= stream->numSlots)
+        stream->numSlots = slot + 1;
+}
+
+// Heap configuration shared by all workloads
+static const OffsetType HEAP_SIZE = 256 * 1024 * 1024;
+#ifdef USE_16_BIT_NODE_INDICES
+static const uint32 MAX_ALLOCS = 64 * 1024;
+static const uint32 LIVE_SLOTS = 16 * 1024;
+#else
+static const uint32 MAX_ALLOCS = 128 * 1024;
+static const uint32 LIVE_SLOTS = 32 * 1024;
+#endif
+
+// Random slot toggling: allocate into empty slots, free occupied ones
+static void generateToggle(OpStream* stream,
+                           uint32 numOps,
+                           OffsetType (*sizeFn)(void)) {
+    bool* occupied = (bool*)calloc(LIVE_SLOTS, sizeof(bool));
+    for (uint32 i = 0; i < numOps; i++) {
+        uint32 slot = rngNext() % LIVE_SLOTS;
+        if (occupied[slot]) {
+            pushOp(stream, OP_FREE, slot, 0);
+        } else {
+            pushOp(stream, OP_ALLOCATE, slot, sizeFn());
+        }
+        occupied[slot] = !occupied[slot];
+    }
+    free(occupied);
+}
+
+static OffsetType uniformSize(void) {
+    return 1 + rngNext() % (16 * 1024);
+}
+
+// Pareto (alpha = 1) distributed sizes: many tiny allocations, a long tail of
+// huge ones
+static OffsetType powerLawSize(void) {
+    double size = 16.0 / rngUnit();
+    return size > 4 * 1024 * 1024 ? 4 * 1024 * 1024 : (OffsetType)size;
+}
+
+static void generateUniform(OpStream* stream, uint32 numOps) {
+    generateToggle(stream, numOps, uniformSize);
+}
+
+static void generatePowerLaw(OpStream* stream, uint32 numOps) {
+    generateToggle(stream, numOps, powerLawSize);
+}
+
+// Per frame: a few long lived resources are replaced, and a burst of small
+// transient allocations is made and released at the end of the frame
+static void generateFrameChurn(OpStream* stream, uint32 numOps) {
+    const uint32 longLivedSlots = LIVE_SLOTS / 2;
+    const uint32 transientsPerFrame = 256;
+
+    bool* occupied = (bool*)calloc(longLivedSlots, sizeof(bool));
+    while (stream->count < numOps) {
+        for (uint32 i = 0; i < 8; i++) {
+            uint32 slot = rngNext() % longLivedSlots;
+            if (occupied[slot])
+                pushOp(stream, OP_FREE, slot, 0);
+            pushOp(stream, OP_ALLOCATE, slot, 1024 + rngNext() % (64 * 1024));
+            occupied[slot] = true;
+        }
+        for (uint32 i = 0; i < transientsPerFrame; i++) {
+            pushOp(stream, OP_ALLOCATE, longLivedSlots + i,
+                   16 + rngNext() % 1024);
+        }
+        for (uint32 i = 0; i < transientsPerFrame; i++) {
+            pushOp(stream, OP_FREE, longLivedSlots + i, 0);
+        }
+    }
+    free(occupied);
+}
+
+static bool loadTrace(OpStream* stream, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Can't open trace: %s\n", path);
+        return false;
+    }
+    char type;
+    unsigned long slot;
+    unsigned long long size;
+    while (fscanf(file, " %c %lu", &type, &slot) == 2) {
+        if (type == 'a' && fscanf(file, " %llu", &size) == 1) {
+            pushOp(stream, OP_ALLOCATE, (uint32)slot, (OffsetType)size);
+        } else if (type == 'f') {
+            pushOp(stream, OP_FREE, (uint32)slot, 0);
+        } else {
+            break;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// Replay
+static AllocatorPolicy benchPolicy = ALLOCATOR_POLICY_FIRST_FIT;
+
+typedef struct {
+    double nsPerOp;
+    uint32 p50;
+    uint32 p99;
+    uint32 p999;
+    uint32 failures;
+    double fragmentation;
+} BenchResult;
+
+static int compareUint32(const void* a, const void* b) {
+    uint32 x = *(const uint32*)a;
+    uint32 y = *(const uint32*)b;
+    return (x > y) - (x < y);
+}
+
+static uint32 replay(const OpStream* stream,
+                     Allocation* slots,
+                     uint32* latencies,
+                     FILE* curves,
+                     const char* name,
+                     double* endFragmentation) {
+    Allocator allocator;
+    initAllocator(&allocator, HEAP_SIZE, MAX_ALLOCS);
+    setAllocatorPolicy(&allocator, benchPolicy);
+
+    Allocation empty = EmptyAllocation;
+    for (uint32 i = 0; i < stream->numSlots; i++) {
+        slots[i] = empty;
+    }
+
+    uint32 failures = 0;
+    uint32 curveStep = stream->count / 64 ? stream->count / 64 : 1;
+    for (uint32 i = 0; i < stream->count; i++) {
+        const Op* op = &stream->ops[i];
+        uint64 start = latencies ? nowNs() : 0;
+        if (op->type == OP_ALLOCATE) {
+            slots[op->slot] = allocate(&allocator, op->size);
+            failures += slots[op->slot].offset == NO_SPACE;
+        } else if (slots[op->slot].offset != NO_SPACE) {
+            freeAllocation(&allocator, slots[op->slot]);
+            slots[op->slot] = empty;
+        }
+        if (latencies)
+            latencies[i] = (uint32)(nowNs() - start);
+
+        if (curves && (i % curveStep) == 0) {
+            StorageReport report = storageReport(&allocator);
+            fprintf(curves, "%s,%u,%llu,%llu,%.4f\n", name, i,
+                    (unsigned long long)report.totalFreeSpace,
+                    (unsigned long long)report.largestFreeRegion,
+                    fragmentationScore(&allocator));
+        }
+    }
+
+    *endFragmentation = fragmentationScore(&allocator);
+    terminateAllocator(&allocator);
+    return failures;
+}
+
+static BenchResult runBenchmark(const OpStream* stream,
+                                FILE* curves,
+                                const char* name) {
+    BenchResult result;
+    Allocation* slots =
+        (Allocation*)malloc(stream->numSlots * sizeof(Allocation));
+    uint32* latencies = (uint32*)malloc(stream->count * sizeof(uint32));
+
+    // Throughput: best of a few runs to filter out scheduler noise
+    double best = 1e30;
+    for (uint32 run = 0; run < 3; run++) {
+        uint64 start = nowNs();
+        result.failures = replay(stream, slots, NULL, NULL, name,
+                                 &result.fragmentation);
+        double ns = (double)(nowNs() - start) / stream->count;
+        if (ns < best)
+            best = ns;
+    }
+    result.nsPerOp = best;
+
+    // Latency: timed per op (includes the timer overhead)
+    replay(stream, slots, latencies, curves, name, &result.fragmentation);
+    qsort(latencies, stream->count, sizeof(uint32), compareUint32);
+    result.p50 = latencies[(uint64)stream->count * 50 / 100];
+    result.p99 = latencies[(uint64)stream->count * 99 / 100];
+    result.p999 = latencies[(uint64)stream->count * 999 / 1000];
+
+    free(latencies);
+    free(slots);
+    return result;
+}
+
+// Baseline comparison
+typedef struct {
+    char name[64];
+    double nsPerOp;
+    uint32 p99;
+} BaselineEntry;
+
+static uint32 loadBaseline(const char* path,
+                           BaselineEntry* entries,
+                           uint32 maxEntries) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Can't open baseline: %s\n", path);
+        return 0;
+    }
+    uint32 count = 0;
+    while (count < maxEntries &&
+           fscanf(file, "%63s %lf %u", entries[count].name,
+                  &entries[count].nsPerOp, &entries[count].p99) == 3) {
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+// Formats the delta to the baseline entry of name (if any). Returns true if
+// it regressed more than threshold percent.
+static bool compareBaseline(const BaselineEntry* baseline,
+                            uint32 numBaseline,
+                            const char* name,
+                            double nsPerOp,
+                            double threshold,
+                            char* versus,
+                            size_t versusSize) {
+    versus[0] = 0;
+    for (uint32 i = 0; i < numBaseline; i++) {
+        if (strcmp(baseline[i].name, name))
+            continue;
+        double delta =
+            100.0 * (nsPerOp - baseline[i].nsPerOp) / baseline[i].nsPerOp;
+        snprintf(versus, versusSize, "%+.1f%%%s", delta,
+                 delta > threshold ? " !!" : "");
+        return delta > threshold;
+    }
+    return false;
+}
+
+static inline uint32 highestSetBit(const OffsetType v) {
+#ifdef _MSC_VER
+    unsigned long retVal;
+    _BitScanReverse64(&retVal, (uint64)v);
+    return retVal;
+#else
+    return 63 - __builtin_clzll((uint64)v);
+#endif
+}
+
+// Bin index micro benchmark: the branchy reference (the implementation
+// before the branchless rewrite), the library scalar path and the batch
+// path (AVX2/NEON when compiled with the target flags).
+static uint32 referenceRoundUp(const OffsetType size) {
+    const uint32 mantissaValue = 1 << MANTISSA_BITS;
+    uint32 exp = 0;
+    uint32 mantissa = 0;
+    if (size < mantissaValue) {
+        mantissa = (uint32)size;
+    } else {
+        uint32 mantissaStartBit = highestSetBit(size) - MANTISSA_BITS;
+        exp = mantissaStartBit + 1;
+        mantissa = (uint32)(size >> mantissaStartBit) & (mantissaValue - 1);
+        OffsetType lowBitsMask = ((OffsetType)1 << mantissaStartBit) - 1;
+        if ((size & lowBitsMask) != 0)
+            mantissa++;
+    }
+    return (exp << MANTISSA_BITS) + mantissa;
+}
+
+typedef uint32 (*BinFunction)(const OffsetType size);
+
+// Called through a volatile pointer so that neither side gets inlined
+static double timeBinFunction(BinFunction volatile* function,
+                              const OffsetType* sizes,
+                              uint32* binIndices,
+                              uint32 count) {
+    double best = 1e30;
+    for (uint32 run = 0; run < 3; run++) {
+        BinFunction f = *function;
+        uint64 start = nowNs();
+        for (uint32 i = 0; i < count; i++) {
+            binIndices[i] = f(sizes[i]);
+        }
+        double ns = (double)(nowNs() - start) / count;
+        if (ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+static double timeBinBatch(const OffsetType* sizes,
+                           uint32* binIndices,
+                           uint32 count) {
+    double best = 1e30;
+    for (uint32 run = 0; run < 3; run++) {
+        uint64 start = nowNs();
+        uintToFloatRoundUpBatch(sizes, binIndices, count);
+        double ns = (double)(nowNs() - start) / count;
+        if (ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+typedef struct {
+    const char* name;
+    double nsPerOp;
+} BinBenchResult;
+
+static void runBinIndexBenchmark(uint32 count, BinBenchResult results[3]) {
+    OffsetType* sizes = (OffsetType*)malloc(count * sizeof(OffsetType));
+    uint32* binIndices = (uint32*)malloc(count * sizeof(uint32));
+    for (uint32 i = 0; i < count; i++) {
+        sizes[i] = (i & 1) ? uniformSize() : powerLawSize();
+    }
+
+    BinFunction volatile reference = referenceRoundUp;
+    BinFunction volatile scalar = uintToFloatRoundUp;
+    results[0].name = "bin_branchy";
+    results[0].nsPerOp = timeBinFunction(&reference, sizes, binIndices, count);
+    results[1].name = "bin_branchless";
+    results[1].nsPerOp = timeBinFunction(&scalar, sizes, binIndices, count);
+    results[2].name = "bin_batch";
+    results[2].nsPerOp = timeBinBatch(sizes, binIndices, count);
+
+    free(binIndices);
+    free(sizes);
+}
+
+typedef struct {
+    const char* name;
+    void (*generate)(OpStream* stream, uint32 numOps);
+} Workload;
+
+int main(int argc, char* argv[]) {
+    const char* filter = NULL;
+    const char* tracePath = NULL;
+    const char* outPath = NULL;
+    const char* baselinePath = NULL;
+    double threshold = 10.0;
+    uint32 numOps = 1000000;
+    bool writeCurves = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--ops") && i + 1 < argc) {
+            numOps = (uint32)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+            threshold = strtod(argv[++i], NULL);
+        } else if (!strcmp(argv[i], "--curves")) {
+            writeCurves = true;
+        } else if (!strcmp(argv[i], "--best-fit")) {
+            benchPolicy = ALLOCATOR_POLICY_BEST_FIT;
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    Workload workloads[] = {
+        {"uniform", generateUniform},
+        {"power_law", generatePowerLaw},
+        {"frame_churn", generateFrameChurn},
+        {"trace", NULL},
+    };
+    const uint32 numWorkloads = sizeof(workloads) / sizeof(Workload);
+
+    BaselineEntry baseline[16];
+    uint32 numBaseline =
+        baselinePath ? loadBaseline(baselinePath, baseline, 16) : 0;
+
+    FILE* out = outPath ? fopen(outPath, "w") : NULL;
+    FILE* curves = writeCurves ? stdout : NULL;
+
+    printf("Config: offsets=%u bit, node indices=%u bit, mantissa bits=%u, "
+           "packed nodes=%s, policy=%s\n",
+           (uint32)sizeof(OffsetType) * 8, (uint32)sizeof(NodeIndex) * 8,
+           (uint32)MANTISSA_BITS,
+#ifdef USE_PACKED_NODES
+           "yes",
+#else
+           "no",
+#endif
+           benchPolicy == ALLOCATOR_POLICY_BEST_FIT ? "best fit" : "first fit");
+    printf("%-16s %10s %10s %8s %8s %8s %8s %8s %9s\n", "Benchmark", "ns/op",
+           "Mops/s", "p50", "p99", "p99.9", "frag", "fails", "vs base");
+    printf("-------------------------------------------------------------"
+           "-------------------------------\n");
+
+    int exitCode = 0;
+    for (uint32 w = 0; w < numWorkloads; w++) {
+        const Workload* workload = &workloads[w];
+        if (filter && !strstr(workload->name, filter))
+            continue;
+
+        OpStream stream = {0};
+        if (workload->generate) {
+            workload->generate(&stream, numOps);
+        } else if (!tracePath || !loadTrace(&stream, tracePath)) {
+            continue;
+        }
+        if (stream.count == 0)
+            continue;
+
+        if (curves)
+            fprintf(curves, "# curve,op,totalFree,largestFree,fragmentation\n");
+        BenchResult result = runBenchmark(&stream, curves, workload->name);
+
+        char versus[32];
+        if (compareBaseline(baseline, numBaseline, workload->name,
+                            result.nsPerOp, threshold, versus,
+                            sizeof(versus))) {
+            exitCode = 1;
+        }
+
+        printf("%-16s %10.2f %10.2f %8u %8u %8u %8.3f %8u %9s\n",
+               workload->name, result.nsPerOp, 1000.0 / result.nsPerOp,
+               result.p50, result.p99, result.p999, result.fragmentation,
+               result.failures, versus);
+        if (out)
+            fprintf(out, "%s %.3f %u\n", workload->name, result.nsPerOp,
+                    result.p99);
+
+        free(stream.ops);
+    }
+
+    if (!filter || strstr("bin_index", filter)) {
+        BinBenchResult binResults[3];
+        runBinIndexBenchmark(numOps, binResults);
+        printf("\n%-16s %10s %10s %9s\n", "Bin index", "ns/size",
+               "Msizes/s", "vs base");
+        for (uint32 i = 0; i < 3; i++) {
+            char versus[32];
+            if (compareBaseline(baseline, numBaseline, binResults[i].name,
+                                binResults[i].nsPerOp, threshold, versus,
+                                sizeof(versus))) {
+                exitCode = 1;
+            }
+            printf("%-16s %10.2f %10.2f %9s\n", binResults[i].name,
+                   binResults[i].nsPerOp, 1000.0 / binResults[i].nsPerOp,
+                   versus);
+            if (out)
+                fprintf(out, "%s %.3f 0\n", binResults[i].name,
+                        binResults[i].nsPerOp);
+        }
+    }
+
+    if (out)
+        fclose(out);
+    if (exitCode)
+        printf("Regression above %.1f%% threshold\n", threshold);
+    return exitCode;
+}
@@ -0,0 +1,259 @@
+// MIT License (see file: LICENSE)
+
+#include "heapManager.h"
+#include <stdlib.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline uint32 tzcnt_nonzero64(uint64 v) {
+#ifdef _MSC_VER
+    unsigned long retVal;
+    _BitScanForward64(&retVal, v);
+    return retVal;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static inline uint32 popcount64(uint64 v) {
+#ifdef _MSC_VER
+    return (uint32)__popcnt64(v);
+#else
+    return (uint32)__builtin_popcountll(v);
+#endif
+}
+
+// Moves the block to the top bin mask of its largest free region bin
+static void setBlockBin(HeapPool* pool,
+                        const uint32 blockIndex,
+                        const uint32 binIndex) {
+    HeapBlock* block = &pool->m_blocks[blockIndex];
+    HeapBlockMask blockBit = 1ull << blockIndex;
+
+    if (block->m_largestBin != HEAP_NO_BIN) {
+        uint32 topBin = block->m_largestBin >> TOP_BINS_INDEX_SHIFT;
+        pool->m_blocksByTopBin[topBin] &= ~blockBit;
+        if (pool->m_blocksByTopBin[topBin] == 0)
+            pool->m_usedTopBins &= ~((TopBinsMask)1 << topBin);
+    }
+
+    block->m_largestBin = binIndex;
+    if (binIndex != HEAP_NO_BIN) {
+        uint32 topBin = binIndex >> TOP_BINS_INDEX_SHIFT;
+        pool->m_blocksByTopBin[topBin] |= blockBit;
+        pool->m_usedTopBins |= (TopBinsMask)1 << topBin;
+    }
+}
+
+static void updateBlockBin(HeapPool* pool, const uint32 blockIndex) {
+    // largestFreeRegion is always a bin size: round down gives the bin back
+    OffsetType largest =
+        storageReport(&pool->m_blocks[blockIndex].m_allocator)
+            .largestFreeRegion;
+    setBlockBin(pool, blockIndex,
+                largest ? uintToFloatRoundDown(largest) : HEAP_NO_BIN);
+}
+
+// Returns a live block that can fit the bin, or HEAP_MAX_BLOCKS
+static uint32 findBlock(const HeapPool* pool, const uint32 binIndex) {
+    uint32 topBin = binIndex >> TOP_BINS_INDEX_SHIFT;
+
+    // Same top bin: the leaf bin decides, smallest fitting region first
+    HeapBlockMask candidates = pool->m_blocksByTopBin[topBin];
+    while (candidates) {
+        uint32 blockIndex = tzcnt_nonzero64(candidates);
+        if (pool->m_blocks[blockIndex].m_largestBin >= binIndex)
+            return blockIndex;
+        candidates &= candidates - 1;
+    }
+
+    // Any block in a higher top bin fits. Take the lowest.
+    uint64 higherTopBins = topBin + 1 < NUM_TOP_BINS
+                               ? (uint64)pool->m_usedTopBins &
+                                     (~0ull << (topBin + 1))
+                               : 0;
+    if (higherTopBins) {
+        uint32 higherTopBin = tzcnt_nonzero64(higherTopBins);
+        return tzcnt_nonzero64(pool->m_blocksByTopBin[higherTopBin]);
+    }
+
+    return HEAP_MAX_BLOCKS;
+}
+
+static uint32 createBlock(HeapManager* manager, const uint32 poolIndex) {
+    HeapPool* pool = &manager->m_pools[poolIndex];
+    HeapBlockMask freeBlocks = ~pool->m_liveBlocks;
+    if (pool->m_maxBlocks < HEAP_MAX_BLOCKS)
+        freeBlocks &= (1ull << pool->m_maxBlocks) - 1;
+    if (freeBlocks == 0)
+        return HEAP_MAX_BLOCKS;
+
+    uint32 blockIndex = tzcnt_nonzero64(freeBlocks);
+    if (manager->m_blockCallback &&
+        !manager->m_blockCallback(manager->m_blockUserData, poolIndex,
+                                  blockIndex, pool->m_blockSize, true)) {
+        return HEAP_MAX_BLOCKS;
+    }
+
+    HeapBlock* block = &pool->m_blocks[blockIndex];
+    initAllocator(&block->m_allocator, pool->m_blockSize,
+                  pool->m_maxAllocsPerBlock);
+    block->m_allocationCount = 0;
+    block->m_largestBin = HEAP_NO_BIN;
+    pool->m_liveBlocks |= 1ull << blockIndex;
+    updateBlockBin(pool, blockIndex);
+    return blockIndex;
+}
+
+static void destroyBlock(HeapManager* manager,
+                         const uint32 poolIndex,
+                         const uint32 blockIndex) {
+    HeapPool* pool = &manager->m_pools[poolIndex];
+    HeapBlock* block = &pool->m_blocks[blockIndex];
+
+    setBlockBin(pool, blockIndex, HEAP_NO_BIN);
+    terminateAllocator(&block->m_allocator);
+
+    pool->m_liveBlocks &= ~(1ull << blockIndex);
+    pool->m_emptyBlocks &= ~(1ull << blockIndex);
+    if (manager->m_blockCallback) {
+        manager->m_blockCallback(manager->m_blockUserData, poolIndex,
+                                 blockIndex, pool->m_blockSize, false);
+    }
+}
+
+// Empty: keep a few around, destroy the rest
+static void releaseEmptyBlock(HeapManager* manager,
+                              const uint32 poolIndex,
+                              const uint32 blockIndex) {
+    HeapPool* pool = &manager->m_pools[poolIndex];
+    pool->m_emptyBlocks |= 1ull << blockIndex;
+    if (popcount64(pool->m_emptyBlocks) > HEAP_KEEP_EMPTY_BLOCKS)
+        destroyBlock(manager, poolIndex, blockIndex);
+}
+
+void initHeapManager(HeapManager* manager,
+                     HeapBlockCallback callback,
+                     void* userData) {
+    manager->m_numPools = 0;
+    manager->m_blockCallback = callback;
+    manager->m_blockUserData = userData;
+}
+
+void terminateHeapManager(HeapManager* manager) {
+    for (uint32 i = 0; i < manager->m_numPools; i++) {
+        HeapPool* pool = &manager->m_pools[i];
+        while (pool->m_liveBlocks) {
+            destroyBlock(manager, i, tzcnt_nonzero64(pool->m_liveBlocks));
+        }
+        free(pool->m_blocks);
+        pool->m_blocks = NULL;
+    }
+    manager->m_numPools = 0;
+}
+
+uint32 addHeapPool(HeapManager* manager,
+                   const OffsetType blockSize,
+                   const uint32 max_allocs_per_block,
+                   const uint32 max_blocks) {
+    ASSERT(manager->m_numPools < HEAP_MAX_POOLS);
+    ASSERT(max_blocks > 0 && max_blocks <= HEAP_MAX_BLOCKS);
+
+    uint32 poolIndex = manager->m_numPools++;
+    HeapPool* pool = &manager->m_pools[poolIndex];
+    pool->m_blockSize = blockSize;
+    pool->m_maxAllocsPerBlock = max_allocs_per_block;
+    pool->m_maxBlocks = max_blocks;
+    pool->m_blocks = (HeapBlock*)malloc(max_blocks * sizeof(HeapBlock));
+    pool->m_liveBlocks = 0;
+    pool->m_emptyBlocks = 0;
+    pool->m_usedTopBins = 0;
+    for (uint32 i = 0; i < NUM_TOP_BINS; i++) {
+        pool->m_blocksByTopBin[i] = 0;
+    }
+    return poolIndex;
+}
+
+HeapAllocation heapAllocate(HeapManager* manager,
+                            const uint32 poolIndex,
+                            const OffsetType size) {
+    ASSERT(poolIndex < manager->m_numPools);
+    HeapPool* pool = &manager->m_pools[poolIndex];
+    HeapAllocation res = {.allocation = EmptyAllocation,
+                          .pool = poolIndex,
+                          .block = HEAP_MAX_BLOCKS};
+    // Larger than the bin of a whole empty block: no block can hold it
+    uint32 binIndex = uintToFloatRoundUp(size);
+    if (size > pool->m_blockSize ||
+        binIndex > uintToFloatRoundDown(pool->m_blockSize))
+        return res;
+
+    uint32 blockIndex = findBlock(pool, binIndex);
+    if (blockIndex == HEAP_MAX_BLOCKS) {
+        blockIndex = createBlock(manager, poolIndex);
+        if (blockIndex == HEAP_MAX_BLOCKS)
+            return res;
+    }
+
+    // The cached bin guarantees the fit, unless the block is out of nodes
+    // (then storageReport() reports no free space and it's not a candidate)
+    HeapBlock* block = &pool->m_blocks[blockIndex];
+    res.allocation = allocate(&block->m_allocator, size);
+    if (res.allocation.offset == NO_SPACE) {
+        if (block->m_allocationCount == 0)
+            releaseEmptyBlock(manager, poolIndex, blockIndex);
+        return res;
+    }
+
+    res.block = blockIndex;
+    block->m_allocationCount++;
+    pool->m_emptyBlocks &= ~(1ull << blockIndex);
+    updateBlockBin(pool, blockIndex);
+    return res;
+}
+
+void heapFree(HeapManager* manager, HeapAllocation allocation) {
+    ASSERT(allocation.pool < manager->m_numPools);
+    HeapPool* pool = &manager->m_pools[allocation.pool];
+    ASSERT(pool->m_liveBlocks & (1ull << allocation.block));
+    HeapBlock* block = &pool->m_blocks[allocation.block];
+
+    freeAllocation(&block->m_allocator, allocation.allocation);
+    updateBlockBin(pool, allocation.block);
+
+    if (--block->m_allocationCount == 0)
+        releaseEmptyBlock(manager, allocation.pool, allocation.block);
+}
+
+uint32 heapPoolBlockCount(const HeapManager* manager, const uint32 pool) {
+    ASSERT(pool < manager->m_numPools);
+    return popcount64(manager->m_pools[pool].m_liveBlocks);
+}
+
+StorageReport heapPoolStorageReport(const HeapManager* manager,
+                                    const uint32 poolIndex) {
+    ASSERT(poolIndex < manager->m_numPools);
+    const HeapPool* pool = &manager->m_pools[poolIndex];
+    StorageReport report = {.totalFreeSpace = 0, .largestFreeRegion = 0};
+
+    HeapBlockMask blocks = pool->m_liveBlocks;
+    while (blocks) {
+        uint32 blockIndex = tzcnt_nonzero64(blocks);
+        StorageReport blockReport =
+            storageReport(&pool->m_blocks[blockIndex].m_allocator);
+        report.totalFreeSpace += blockReport.totalFreeSpace;
+        if (blockReport.largestFreeRegion > report.largestFreeRegion)
+            report.largestFreeRegion = blockReport.largestFreeRegion;
+        blocks &= blocks - 1;
+    }
+    return report;
+}
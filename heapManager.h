@@ -0,0 +1,92 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocator.h"
+
+// Manager for multiple heaps (e.g. one pool per GPU memory type), each a
+// dynamic list of fixed size blocks with one Allocator per block.
+//
+// Every live block caches the bin of its largest free region, and the pool
+// keeps a mask of blocks per top bin of that bin. An allocation picks a
+// block from the lowest top bin above the request (any of those fits) with
+// a couple of bit scans, instead of trying each block in turn. Only blocks
+// in the request's own top bin need their cached bin compared.
+//
+// When every block is full a new one is created. Empty blocks are kept
+// around up to HEAP_KEEP_EMPTY_BLOCKS per pool so that a workload hovering
+// around a block boundary doesn't create and destroy blocks every frame.
+//
+// The optional block callback is where the caller creates (create == true)
+// and destroys the backing memory. Returning false from a create fails the
+// allocation. Not thread safe.
+
+#define HEAP_MAX_POOLS 8
+#define HEAP_MAX_BLOCKS 64  // Per pool, one bit each in the block masks
+#define HEAP_KEEP_EMPTY_BLOCKS 1
+
+#define HEAP_NO_BIN 0xffffffff
+
+typedef uint64 HeapBlockMask;
+
+typedef bool (*HeapBlockCallback)(void* userData,
+                                  uint32 pool,
+                                  uint32 block,
+                                  OffsetType size,
+                                  bool create);
+
+typedef struct {
+    Allocation allocation;
+    uint32 pool;
+    uint32 block;
+} HeapAllocation;
+
+typedef struct {
+    Allocator m_allocator;
+    uint32 m_allocationCount;
+    uint32 m_largestBin;  // Bin of the largest free region, or HEAP_NO_BIN
+} HeapBlock;
+
+typedef struct {
+    OffsetType m_blockSize;
+    uint32 m_maxAllocsPerBlock;
+    uint32 m_maxBlocks;
+    HeapBlock* m_blocks;
+    HeapBlockMask m_liveBlocks;
+    HeapBlockMask m_emptyBlocks;
+    TopBinsMask m_usedTopBins;  // Top bins with a non-empty block mask
+    HeapBlockMask m_blocksByTopBin[NUM_TOP_BINS];
+} HeapPool;
+
+typedef struct {
+    uint32 m_numPools;
+    HeapPool m_pools[HEAP_MAX_POOLS];
+    HeapBlockCallback m_blockCallback;
+    void* m_blockUserData;
+} HeapManager;
+
+void initHeapManager(HeapManager* manager,
+                     HeapBlockCallback callback,
+                     void* userData);
+
+// Destroys all blocks of all pools
+void terminateHeapManager(HeapManager* manager);
+
+// Returns the pool index. No blocks are created until the first allocation.
+uint32 addHeapPool(HeapManager* manager,
+                   const OffsetType blockSize,
+                   const uint32 max_allocs_per_block,
+                   const uint32 max_blocks);
+
+// allocation.offset is NO_SPACE if it doesn't fit a block (or the pool is
+// out of blocks). Offsets are relative to the block.
+HeapAllocation heapAllocate(HeapManager* manager,
+                            const uint32 pool,
+                            const OffsetType size);
+
+void heapFree(HeapManager* manager, HeapAllocation allocation);
+
+uint32 heapPoolBlockCount(const HeapManager* manager, const uint32 pool);
+
+// Sum over the live blocks of the pool
+StorageReport heapPoolStorageReport(const HeapManager* manager,
+                                    const uint32 pool);
@@ -0,0 +1,145 @@
+// MIT License (see file: LICENSE)
+
+#include "linearAllocator.h"
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+static inline OffsetType alignOffset(const OffsetType offset,
+                                     const OffsetType alignment) {
+    ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// Linear...
+void initLinearAllocator(LinearAllocator* linear,
+                         Allocator* allocator,
+                         const OffsetType blockSize) {
+    Allocation empty = EmptyAllocation;
+    linear->m_allocator = allocator;
+    linear->m_block = empty;
+    linear->m_blockSize = blockSize;
+    linear->m_head = 0;
+}
+
+OffsetType linearAllocate(LinearAllocator* linear,
+                          const OffsetType size,
+                          const OffsetType alignment) {
+    // Carve the block on first use after a reset
+    if (linear->m_block.offset == NO_SPACE) {
+        linear->m_block = allocate(linear->m_allocator, linear->m_blockSize);
+        if (linear->m_block.offset == NO_SPACE)
+            return NO_SPACE;
+    }
+
+    OffsetType base = linear->m_block.offset;
+    OffsetType offset = alignOffset(base + linear->m_head, alignment);
+    if (offset - base > linear->m_blockSize ||
+        size > linear->m_blockSize - (offset - base)) {
+        return NO_SPACE;
+    }
+
+    linear->m_head = offset - base + size;
+    return offset;
+}
+
+void resetLinearAllocator(LinearAllocator* linear) {
+    if (linear->m_block.offset != NO_SPACE) {
+        Allocation empty = EmptyAllocation;
+        freeAllocation(linear->m_allocator, linear->m_block);
+        linear->m_block = empty;
+    }
+    linear->m_head = 0;
+}
+
+StorageReport linearStorageReport(const LinearAllocator* linear) {
+    OffsetType freeSpace = linear->m_blockSize - linear->m_head;
+    StorageReport report = {.totalFreeSpace = freeSpace,
+                            .largestFreeRegion = freeSpace};
+    return report;
+}
+
+// Ring...
+bool initRingAllocator(RingAllocator* ring,
+                       Allocator* allocator,
+                       const OffsetType blockSize) {
+    ring->m_allocator = allocator;
+    ring->m_block = allocate(allocator, blockSize);
+    ring->m_blockSize = blockSize;
+    ring->m_headOffset = 0;
+    ring->m_head = 0;
+    ring->m_tail = 0;
+    return ring->m_block.offset != NO_SPACE;
+}
+
+void terminateRingAllocator(RingAllocator* ring) {
+    if (ring->m_block.offset != NO_SPACE) {
+        Allocation empty = EmptyAllocation;
+        freeAllocation(ring->m_allocator, ring->m_block);
+        ring->m_block = empty;
+    }
+}
+
+OffsetType ringAllocate(RingAllocator* ring,
+                        const OffsetType size,
+                        const OffsetType alignment) {
+    if (ring->m_block.offset == NO_SPACE || size > ring->m_blockSize)
+        return NO_SPACE;
+
+    OffsetType base = ring->m_block.offset;
+    OffsetType offset = alignOffset(base + ring->m_headOffset, alignment);
+    OffsetType padding = offset - base - ring->m_headOffset;
+
+    // Doesn't fit before the end: skip the rest and wrap around
+    if (offset - base > ring->m_blockSize ||
+        size > ring->m_blockSize - (offset - base)) {
+        offset = alignOffset(base, alignment);
+        if (offset - base > ring->m_blockSize ||
+            size > ring->m_blockSize - (offset - base)) {
+            return NO_SPACE;
+        }
+        padding = ring->m_blockSize - ring->m_headOffset + (offset - base);
+    }
+
+    // Must not run into the unreleased data
+    uint64 used = ring->m_head - ring->m_tail;
+    if (used + padding + size > ring->m_blockSize)
+        return NO_SPACE;
+
+    ring->m_head += padding + size;
+    ring->m_headOffset = offset - base + size;
+    if (ring->m_headOffset == ring->m_blockSize)
+        ring->m_headOffset = 0;
+    return offset;
+}
+
+uint64 ringAllocatorMarker(const RingAllocator* ring) {
+    return ring->m_head;
+}
+
+void releaseRingAllocator(RingAllocator* ring, const uint64 marker) {
+    ASSERT(marker >= ring->m_tail && marker <= ring->m_head);
+    ring->m_tail = marker;
+}
+
+StorageReport ringStorageReport(const RingAllocator* ring) {
+    OffsetType freeSpace = (OffsetType)(ring->m_blockSize -
+                                        (ring->m_head - ring->m_tail));
+    OffsetType largestFreeRegion = freeSpace;
+    if (freeSpace > 0 && freeSpace < ring->m_blockSize) {
+        // Free space may be split in two around the end of the block
+        OffsetType tailOffset =
+            (OffsetType)(ring->m_tail % ring->m_blockSize);
+        if (tailOffset <= ring->m_headOffset) {
+            OffsetType end = ring->m_blockSize - ring->m_headOffset;
+            largestFreeRegion = end > tailOffset ? end : tailOffset;
+        }
+    }
+    StorageReport report = {.totalFreeSpace = freeSpace,
+                            .largestFreeRegion = largestFreeRegion};
+    return report;
+}
@@ -0,0 +1,70 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocator.h"
+
+// Sub-allocators for transient data, layered on a single Allocation.
+//
+// LinearAllocator: bump allocator for data released all at once (per frame
+// uploads, constants). The block is carved from the parent on the first
+// allocation, every allocation is a single add, and resetLinearAllocator()
+// hands the whole block back. Between resets the parent's storageReport()
+// counts the full block as used.
+//
+// RingAllocator: FIFO for streaming data that outlives a frame. The block is
+// carved once at init. Allocations are released in order: take a marker with
+// ringAllocatorMarker() at frame end and pass it to releaseRingAllocator()
+// once the frame's data is consumed (e.g. its GPU fence has completed).
+//
+// Offsets are in the parent's range. Neither is thread safe.
+
+typedef struct {
+    Allocator* m_allocator;
+    Allocation m_block;  // EmptyAllocation until the first allocation
+    OffsetType m_blockSize;
+    OffsetType m_head;  // Next free offset, relative to the block
+} LinearAllocator;
+
+typedef struct {
+    Allocator* m_allocator;
+    Allocation m_block;
+    OffsetType m_blockSize;
+    OffsetType m_headOffset;  // m_head % m_blockSize
+    uint64 m_head;            // Total consumed, never wraps
+    uint64 m_tail;            // Total released
+} RingAllocator;
+
+void initLinearAllocator(LinearAllocator* linear,
+                         Allocator* allocator,
+                         const OffsetType blockSize);
+
+// Returns NO_SPACE when the block is full (or can't be carved)
+OffsetType linearAllocate(LinearAllocator* linear,
+                          const OffsetType size,
+                          const OffsetType alignment);
+
+// Frees everything and returns the block to the parent
+void resetLinearAllocator(LinearAllocator* linear);
+
+// Free space left in the current block (all of it if none is carved)
+StorageReport linearStorageReport(const LinearAllocator* linear);
+
+// Returns false if the parent can't fit blockSize
+bool initRingAllocator(RingAllocator* ring,
+                       Allocator* allocator,
+                       const OffsetType blockSize);
+
+void terminateRingAllocator(RingAllocator* ring);
+
+// Returns NO_SPACE when the unreleased data leaves no room
+OffsetType ringAllocate(RingAllocator* ring,
+                        const OffsetType size,
+                        const OffsetType alignment);
+
+// Position after the latest allocation
+uint64 ringAllocatorMarker(const RingAllocator* ring);
+
+// Releases everything allocated before the marker
+void releaseRingAllocator(RingAllocator* ring, const uint64 marker);
+
+StorageReport ringStorageReport(const RingAllocator* ring);
@@ -17,10 +17,31 @@
 #include <stdio.h>
 #endif
 
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+#define INSTRUMENT(x) x
+#else
+#define INSTRUMENT(x)
+#endif
+
+#ifdef USE_ALLOCATOR_TRACE
+#include "allocatorTrace.h"
+#define TRACE(x) x
+#else
+#define TRACE(x)
+#endif
+
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
 
+// Vectorized batch bin computation, picked by the target flags
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define OFFSET_ALLOCATOR_NEON
+#include <arm_neon.h>
+#endif
+
 #include <string.h>
 
 static inline uint32 lzcnt_nonzero(uint32 v) {
@@ -43,119 +64,426 @@ static inline uint32 tzcnt_nonzero(uint32 v) {
 #endif
 }
 
-static const uint32 MANTISSA_BITS = 3;
+#if defined(USE_64_BIT_OFFSETS) || MANTISSA_BITS == 6
+static inline uint32 lzcnt_nonzero64(uint64 v) {
+#ifdef _MSC_VER
+    unsigned long retVal;
+    _BitScanReverse64(&retVal, v);
+    return 63 - retVal;
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+static inline uint32 tzcnt_nonzero64(uint64 v) {
+#ifdef _MSC_VER
+    unsigned long retVal;
+    _BitScanForward64(&retVal, v);
+    return retVal;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+#endif
+
+// Remote free stack atomics. Push is a CAS loop, the owner takes the whole
+// stack at once with an exchange, so there is no ABA problem.
+static inline long atomicLoad(volatile long* target) {
+#ifdef _MSC_VER
+    return *target;
+#else
+    return __atomic_load_n(target, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline long atomicExchange(volatile long* target, long value) {
+#ifdef _MSC_VER
+    return _InterlockedExchange(target, value);
+#else
+    return __atomic_exchange_n(target, value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline bool atomicCompareExchange(volatile long* target,
+                                         long expected,
+                                         long desired) {
+#ifdef _MSC_VER
+    return _InterlockedCompareExchange(target, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(target, &expected, desired, true,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline uint32 highestSetBit(const OffsetType v) {
+#ifdef USE_64_BIT_OFFSETS
+    return 63 - lzcnt_nonzero64(v);
+#else
+    return 31 - lzcnt_nonzero(v);
+#endif
+}
+
+// Top level bitfield is 32 or 64 bits wide (USE_64_BIT_OFFSETS)
+static inline uint32 lowestTopBin(const TopBinsMask v) {
+#ifdef USE_64_BIT_OFFSETS
+    return tzcnt_nonzero64(v);
+#else
+    return tzcnt_nonzero(v);
+#endif
+}
+
+static inline uint32 highestTopBin(const TopBinsMask v) {
+#ifdef USE_64_BIT_OFFSETS
+    return 63 - lzcnt_nonzero64(v);
+#else
+    return 31 - lzcnt_nonzero(v);
+#endif
+}
+
+// Leaf level bitfield is 2^MANTISSA_BITS bits wide
+static inline uint32 lowestLeafBin(const LeafBinsMask v) {
+#if MANTISSA_BITS == 6
+    return tzcnt_nonzero64(v);
+#else
+    return tzcnt_nonzero(v);
+#endif
+}
+
+static inline uint32 highestLeafBin(const LeafBinsMask v) {
+#if MANTISSA_BITS == 6
+    return 63 - lzcnt_nonzero64(v);
+#else
+    return 31 - lzcnt_nonzero(v);
+#endif
+}
+
 static const uint32 MANTISSA_VALUE = 1 << MANTISSA_BITS;
 static const uint32 MANTISSA_MASK = MANTISSA_VALUE - 1;
-static const NodeIndex NODE_UNUSED = 0xffffffff;
-const uint32 NO_SPACE = 0xffffffff;
+const NodeIndex NODE_UNUSED = (NodeIndex)0xffffffff;
+const OffsetType NO_SPACE = (OffsetType)0xffffffffffffffffull;
+
+// Bitfield search result when no bin was found
+static const uint32 BIN_NONE = 0xffffffff;
 
+// Hot node data: everything the neighbor merge in freeAllocation() touches.
+// The bin list links are only needed while a node sits in a bin, so they are
+// kept in a separate array (m_binLinks) to keep merges cache friendly.
 struct _Node {
-    uint32 dataOffset;
-    uint32 dataSize;
-    NodeIndex binListPrev;
-    NodeIndex binListNext;
+    OffsetType dataOffset;
+    OffsetType dataSize;  // USE_PACKED_NODES: top bit = used
     NodeIndex neighborPrev;
     NodeIndex neighborNext;
-    bool used;  // TODO: Merge as bit flag
+#ifndef USE_PACKED_NODES
+    bool used;
+#endif
+};
+
+struct _BinLinks {
+    NodeIndex binListPrev;
+    NodeIndex binListNext;
 };
 
+#ifdef USE_PACKED_NODES
+static const OffsetType NODE_USED_BIT = (OffsetType)1
+                                        << (sizeof(OffsetType) * 8 - 1);
+#endif
+
+static inline OffsetType nodeSize(const struct _Node* node) {
+#ifdef USE_PACKED_NODES
+    return node->dataSize & ~NODE_USED_BIT;
+#else
+    return node->dataSize;
+#endif
+}
+
+static inline bool nodeUsed(const struct _Node* node) {
+#ifdef USE_PACKED_NODES
+    return (node->dataSize & NODE_USED_BIT) != 0;
+#else
+    return node->used;
+#endif
+}
+
+// Changes the size, keeps the used flag
+static inline void setNodeSize(struct _Node* node, const OffsetType size) {
+#ifdef USE_PACKED_NODES
+    node->dataSize = (node->dataSize & NODE_USED_BIT) | size;
+#else
+    node->dataSize = size;
+#endif
+}
+
+static inline void setNodeUsed(struct _Node* node, const bool used) {
+#ifdef USE_PACKED_NODES
+    node->dataSize = used ? (node->dataSize | NODE_USED_BIT)
+                          : (node->dataSize & ~NODE_USED_BIT);
+#else
+    node->used = used;
+#endif
+}
+
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+static inline void emitEvent(const Allocator* allocator,
+                             const AllocatorEventType type,
+                             const OffsetType offset,
+                             const OffsetType size) {
+    if (allocator->m_eventCallback) {
+        allocator->m_eventCallback(allocator->m_eventUserData, type, offset,
+                                   size, uintToFloatRoundUp(size));
+    }
+}
+
+static void recordAllocate(Allocator* allocator,
+                           const Allocation allocation,
+                           const OffsetType size) {
+    AllocatorStats* stats = &allocator->m_stats;
+    stats->allocations++;
+    OffsetType usedStorage = allocator->m_size - allocator->m_freeStorage;
+    if (usedStorage > stats->maxUsedStorage)
+        stats->maxUsedStorage = usedStorage;
+    emitEvent(allocator, ALLOCATOR_EVENT_ALLOCATE, allocation.offset, size);
+}
+
+static void recordFailure(Allocator* allocator, const OffsetType size) {
+    AllocatorStats* stats = &allocator->m_stats;
+    stats->failures++;
+    uint32 binIndex = uintToFloatRoundUp(size);
+    if (binIndex < NUM_LEAF_BINS)
+        stats->failuresByBin[binIndex]++;
+    emitEvent(allocator, ALLOCATOR_EVENT_FAILURE, NO_SPACE, size);
+}
+
+static void recordFree(Allocator* allocator, const uint32 nodeIndex) {
+    allocator->m_stats.frees++;
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    emitEvent(allocator, ALLOCATOR_EVENT_FREE, node->dataOffset,
+              nodeSize(node));
+}
+
+static void recordNodeUsage(Allocator* allocator) {
+    uint32 usedNodes = allocator->m_maxAllocs - allocator->m_freeOffset - 1;
+    if (usedNodes > allocator->m_stats.maxUsedNodes)
+        allocator->m_stats.maxUsedNodes = usedNodes;
+}
+#endif
+
+static inline void setHandleGeneration(const Allocator* allocator,
+                                       Allocation* allocation) {
+#ifdef USE_GENERATIONAL_HANDLES
+    allocation->generation = allocator->m_generations[allocation->metadata];
+#else
+    (void)allocator;
+    (void)allocation;
+#endif
+}
+
+// Invalidates all handles of a node (on free)
+static inline void bumpNodeGeneration(Allocator* allocator,
+                                      const uint32 nodeIndex) {
+#ifdef USE_GENERATIONAL_HANDLES
+    allocator->m_generations[nodeIndex]++;
+#else
+    (void)allocator;
+    (void)nodeIndex;
+#endif
+}
+
 static uint32 insertNodeIntoBin(Allocator* allocator,
-                                const uint32 size,
-                                const uint32 dataOffset);
+                                const OffsetType size,
+                                const OffsetType dataOffset);
+
+static void linkNodeIntoBin(Allocator* allocator, const uint32 nodeIndex);
+
+static void insertReminderAfter(Allocator* allocator,
+                                const uint32 nodeIndex,
+                                const OffsetType reminderSize);
+
+static void unlinkNodeFromBin(Allocator* allocator, const uint32 nodeIndex);
 
 static void removeNodeFromBin(Allocator* allocator, const uint32 nodeIndex);
 
 StorageReport storageReport(const Allocator* allocator);
 StorageReportFull storageReportFull(const Allocator* allocator);
 
-#define EmptyNode \
-    { 0, 0, unused, unused, unused, unused, false }
-
 // Bin sizes follow floating point (exponent + mantissa) distribution (piecewise
 // linear log approx) This ensures that for each size class, the average
 // overhead percentage stays the same
-uint32 uintToFloatRoundUp(const uint32 size) {
-    uint32 exp = 0;
-    uint32 mantissa = 0;
-
-    if (size < MANTISSA_VALUE) {
-        // Denorm: 0..(MANTISSA_VALUE-1)
-        mantissa = size;
-    } else {
-        // Normalized: Hidden high bit always 1. Not stored. Just like float.
-        uint32 leadingZeros = lzcnt_nonzero(size);
-        uint32 highestSetBit = 31 - leadingZeros;
-
-        uint32 mantissaStartBit = highestSetBit - MANTISSA_BITS;
-        exp = mantissaStartBit + 1;
-        mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
+//
+// Branchless: a normalized size with its top bit at h is (h - MANTISSA_BITS)
+// exponent steps above denorm, and the shifted size already carries the
+// hidden bit, so bin = (shift << MANTISSA_BITS) + (size >> shift).
+// OR-ing in MANTISSA_VALUE makes denorms come out with shift = 0.
+uint32 uintToFloatRoundUp(const OffsetType size) {
+    uint32 shift = highestSetBit(size | MANTISSA_VALUE) - MANTISSA_BITS;
+    OffsetType lowBitsMask = ((OffsetType)1 << shift) - 1;
+
+    // Round up! (+ allows mantissa->exp overflow)
+    return (shift << MANTISSA_BITS) + (uint32)(size >> shift) +
+           ((size & lowBitsMask) != 0);
+}
 
-        uint32 lowBitsMask = (1 << mantissaStartBit) - 1;
+uint32 uintToFloatRoundDown(const OffsetType size) {
+    uint32 shift = highestSetBit(size | MANTISSA_VALUE) - MANTISSA_BITS;
+    return (shift << MANTISSA_BITS) + (uint32)(size >> shift);
+}
 
-        // Round up!
-        if ((size & lowBitsMask) != 0)
-            mantissa++;
-    }
+OffsetType floatToUint(const uint32 floatValue) {
+    uint32 exponent = floatValue >> MANTISSA_BITS;
+    uint32 mantissa = floatValue & MANTISSA_MASK;
 
-    return (exp << MANTISSA_BITS) +
-           mantissa;  // + allows mantissa->exp overflow for round up
+    // Denorms (exponent 0) have no hidden bit and no shift
+    uint32 normalized = exponent != 0;
+    return (OffsetType)(mantissa | (normalized << MANTISSA_BITS))
+           << (exponent - normalized);
 }
 
-uint32 uintToFloatRoundDown(const uint32 size) {
-    uint32 exp = 0;
-    uint32 mantissa = 0;
-
-    if (size < MANTISSA_VALUE) {
-        // Denorm: 0..(MANTISSA_VALUE-1)
-        mantissa = size;
-    } else {
-        // Normalized: Hidden high bit always 1. Not stored. Just like float.
-        uint32 leadingZeros = lzcnt_nonzero(size);
-        uint32 highestSetBit = 31 - leadingZeros;
+#if defined(__AVX2__) && !defined(USE_64_BIT_OFFSETS)
+// 8 sizes at once. AVX2 has no lzcnt: the top bit comes from the exponent
+// of an int->float conversion, done on the high 24 and low 8 bits separately
+// so that the conversion is exact (no round up into the next exponent).
+static inline __m256i uintToFloatRoundUp8(const __m256i size) {
+    __m256i x = _mm256_or_si256(size, _mm256_set1_epi32(MANTISSA_VALUE));
+    __m256i hiFloat =
+        _mm256_castps_si256(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8)));
+    __m256i loFloat = _mm256_castps_si256(_mm256_cvtepi32_ps(
+        _mm256_and_si256(x, _mm256_set1_epi32(0xff))));
+    __m256i hiBit = _mm256_sub_epi32(_mm256_srli_epi32(hiFloat, 23),
+                                     _mm256_set1_epi32(127 - 8));
+    __m256i loBit = _mm256_sub_epi32(_mm256_srli_epi32(loFloat, 23),
+                                     _mm256_set1_epi32(127));
+    __m256i shift = _mm256_sub_epi32(_mm256_max_epi32(hiBit, loBit),
+                                     _mm256_set1_epi32(MANTISSA_BITS));
+
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i lowBits = _mm256_and_si256(
+        size, _mm256_sub_epi32(_mm256_sllv_epi32(one, shift), one));
+    __m256i exact = _mm256_cmpeq_epi32(lowBits, _mm256_setzero_si256());
+    __m256i bin = _mm256_add_epi32(_mm256_slli_epi32(shift, MANTISSA_BITS),
+                                   _mm256_srlv_epi32(size, shift));
+    // Round up: +1, exact lanes add back -1
+    return _mm256_add_epi32(bin, _mm256_add_epi32(one, exact));
+}
+#elif defined(OFFSET_ALLOCATOR_NEON) && !defined(USE_64_BIT_OFFSETS)
+// 4 sizes at once, same math as the scalar version
+static inline uint32x4_t uintToFloatRoundUp4(const uint32x4_t size) {
+    uint32x4_t x = vorrq_u32(size, vdupq_n_u32(MANTISSA_VALUE));
+    int32x4_t shift = vsubq_s32(vdupq_n_s32(31 - MANTISSA_BITS),
+                                vreinterpretq_s32_u32(vclzq_u32(x)));
+
+    uint32x4_t one = vdupq_n_u32(1);
+    uint32x4_t lowBits =
+        vandq_u32(size, vsubq_u32(vshlq_u32(one, shift), one));
+    uint32x4_t bin =
+        vaddq_u32(vshlq_n_u32(vreinterpretq_u32_s32(shift), MANTISSA_BITS),
+                  vshlq_u32(size, vnegq_s32(shift)));
+    return vaddq_u32(bin, vminq_u32(lowBits, one));
+}
+#endif
 
-        uint32 mantissaStartBit = highestSetBit - MANTISSA_BITS;
-        exp = mantissaStartBit + 1;
-        mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
+void uintToFloatRoundUpBatch(const OffsetType* sizes,
+                             uint32* binIndices,
+                             const uint32 count) {
+    uint32 i = 0;
+#if defined(__AVX2__) && !defined(USE_64_BIT_OFFSETS)
+    for (; i + 8 <= count; i += 8) {
+        __m256i size = _mm256_loadu_si256((const __m256i*)&sizes[i]);
+        _mm256_storeu_si256((__m256i*)&binIndices[i],
+                            uintToFloatRoundUp8(size));
+    }
+#elif defined(OFFSET_ALLOCATOR_NEON) && !defined(USE_64_BIT_OFFSETS)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(&binIndices[i], uintToFloatRoundUp4(vld1q_u32(&sizes[i])));
+    }
+#endif
+    for (; i < count; i++) {
+        binIndices[i] = uintToFloatRoundUp(sizes[i]);
     }
+}
 
-    return (exp << MANTISSA_BITS) | mantissa;
+// Node metadata is one block: nodes | bin links | freelist | generations.
+// Every array starts at an 8 byte boundary.
+static inline uint64 alignMetadata(const uint64 bytes) {
+    return (bytes + 7) & ~(uint64)7;
 }
 
-uint32 floatToUint(const uint32 floatValue) {
-    uint32 exponent = floatValue >> MANTISSA_BITS;
-    uint32 mantissa = floatValue & MANTISSA_MASK;
-    if (exponent == 0) {
-        // Denorms
-        return mantissa;
-    } else {
-        return (mantissa | MANTISSA_VALUE) << (exponent - 1);
-    }
+_Static_assert(sizeof(struct _Node) <= ALLOCATOR_NODE_BYTES,
+               "ALLOCATOR_NODE_BYTES is too small for this build");
+_Static_assert(sizeof(struct _BinLinks) == 2 * sizeof(NodeIndex),
+               "ALLOCATOR_METADATA_BYTES assumes unpadded bin links");
+
+uint64 requiredMetadataBytes(const uint32 max_allocs) {
+    uint64 bytes = alignMetadata((uint64)max_allocs * sizeof(struct _Node)) +
+                   alignMetadata((uint64)max_allocs * sizeof(struct _BinLinks)) +
+                   alignMetadata((uint64)max_allocs * sizeof(NodeIndex));
+#ifdef USE_GENERATIONAL_HANDLES
+    bytes += alignMetadata((uint64)max_allocs * sizeof(uint32));
+#endif
+    return bytes;
 }
 
-// Utility functions
-uint32 findLowestSetBitAfter(uint32 bitMask, uint32 startBitIndex) {
-    uint32 maskBeforeStartIndex = (1 << startBitIndex) - 1;
-    uint32 maskAfterStartIndex = ~maskBeforeStartIndex;
-    uint32 bitsAfter = bitMask & maskAfterStartIndex;
-    if (bitsAfter == 0)
-        return NO_SPACE;
-    return tzcnt_nonzero(bitsAfter);
+// Points the node arrays into a metadata block of max_allocs nodes
+static void carveMetadata(Allocator* allocator,
+                          void* storage,
+                          const uint32 max_allocs) {
+    uint8* ptr = (uint8*)storage;
+    allocator->m_metadata = storage;
+    allocator->m_nodes = (Node)ptr;
+    ptr += alignMetadata((uint64)max_allocs * sizeof(struct _Node));
+    allocator->m_binLinks = (BinLinks)ptr;
+    ptr += alignMetadata((uint64)max_allocs * sizeof(struct _BinLinks));
+    allocator->m_freeNodes = (NodeIndex*)ptr;
+#ifdef USE_GENERATIONAL_HANDLES
+    ptr += alignMetadata((uint64)max_allocs * sizeof(NodeIndex));
+    allocator->m_generations = (uint32*)ptr;
+#endif
 }
 
 // Allocator...
 void initAllocator(Allocator* allocator,
-                   const uint32 size,
+                   const OffsetType size,
                    const uint32 max_allocs) {
+    initAllocatorWithStorage(allocator, size, max_allocs, NULL, 0);
+}
+
+void initAllocatorWithStorage(Allocator* allocator,
+                              const OffsetType size,
+                              const uint32 max_allocs,
+                              void* storage,
+                              const uint64 storageBytes) {
     Allocator temp_allocator = {.m_size = size,
                                 .m_maxAllocs = max_allocs,
+                                .m_policy = ALLOCATOR_POLICY_FIRST_FIT,
                                 .m_nodes = NULL,
-                                .m_freeNodes = NULL};
+                                .m_binLinks = NULL,
+                                .m_freeNodes = NULL,
+                                .m_metadata = NULL,
+                                .m_ownsMetadata = storage == NULL,
+                                .m_remoteFrees = 0};
 
     *allocator = temp_allocator;
 
+    // NOTE: 65536 nodes are fine in 16 bit mode. The last node index
+    // (== NODE_UNUSED) stays at the bottom of the freelist and is never popped.
     if (sizeof(NodeIndex) == 2) {
-        ASSERT(maxAllocs <= 65536);
+        ASSERT(max_allocs <= 65536);
+    }
+#ifdef USE_PACKED_NODES
+    // Top bit of the size is the used flag
+    ASSERT(size < NODE_USED_BIT);
+#endif
+
+    if (storage == NULL) {
+        storage = malloc(requiredMetadataBytes(max_allocs));
+    } else {
+        ASSERT(storageBytes >= requiredMetadataBytes(max_allocs));
+        ASSERT(((size_t)storage & 7) == 0);
+        (void)storageBytes;
     }
+    carveMetadata(allocator, storage, max_allocs);
+#ifdef USE_GENERATIONAL_HANDLES
+    allocator->m_generationsUsed = 0;
+#endif
+
     resetAllocator(allocator);
 }
 
@@ -163,6 +491,13 @@ void resetAllocator(Allocator* allocator) {
     allocator->m_freeStorage = 0;
     allocator->m_usedBinsTop = 0;
     allocator->m_freeOffset = allocator->m_maxAllocs - 1;
+    allocator->m_freeHighWater = 0;
+    allocator->m_remoteFrees = 0;
+    allocator->m_deferredFirst = 0;
+    allocator->m_deferredCount = 0;
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+    memset(&allocator->m_stats, 0, sizeof(AllocatorStats));
+#endif
 
     for (uint32 i = 0; i < NUM_TOP_BINS; i++) {
         allocator->m_usedBins[i] = 0;
@@ -170,317 +505,1128 @@ void resetAllocator(Allocator* allocator) {
 
     for (uint32 i = 0; i < NUM_LEAF_BINS; i++) {
         allocator->m_binIndices[i] = NODE_UNUSED;
+        allocator->m_binCounts[i] = 0;
     }
 
-    if (allocator->m_nodes) {
-        free(allocator->m_nodes);
+    // The metadata block is reused. Node contents don't need clearing: a
+    // node is fully initialized when it's taken from the freelist.
+#ifdef USE_GENERATIONAL_HANDLES
+    // Generations survive the reset: bumping them invalidates every handle.
+    // Nodes never handed out have no handles.
+    for (uint32 i = 0; i < allocator->m_generationsUsed; i++) {
+        allocator->m_generations[i]++;
     }
-    if (allocator->m_freeNodes) {
-        free(allocator->m_freeNodes);
+#endif
+
+    // Start state: Whole storage as one big node
+    // Algorithm will split remainders and push them back as smaller nodes
+    allocator->m_defragNode = NODE_UNUSED;
+    allocator->m_tailNode = insertNodeIntoBin(allocator, allocator->m_size, 0);
+    allocator->m_headNode = allocator->m_tailNode;
+    TRACE(traceEventReset(allocator->m_traceId));
+}
+
+bool growAllocator(Allocator* allocator,
+                   const OffsetType newSize,
+                   const uint32 newMaxAllocs) {
+    ASSERT(newSize >= allocator->m_size);
+    ASSERT(newMaxAllocs >= allocator->m_maxAllocs);
+    ASSERT(atomicLoad(&allocator->m_remoteFrees) == 0);  // Drain first
+    if (sizeof(NodeIndex) == 2) {
+        ASSERT(newMaxAllocs <= 65536);
     }
+#ifdef USE_PACKED_NODES
+    ASSERT(newSize < NODE_USED_BIT);
+#endif
 
-    allocator->m_nodes =
-        (Node)calloc(allocator->m_maxAllocs, sizeof(struct _Node));
-    allocator->m_freeNodes =
-        (NodeIndex*)calloc(allocator->m_maxAllocs, sizeof(NodeIndex));
+    uint32 oldMaxAllocs = allocator->m_maxAllocs;
+    if (newMaxAllocs > oldMaxAllocs) {
+        // Caller provided metadata can't be resized
+        if (!allocator->m_ownsMetadata)
+            return false;
+
+        // On failure the old block stays valid
+        void* storage = malloc(requiredMetadataBytes(newMaxAllocs));
+        if (!storage)
+            return false;
+
+        // Only the handed out nodes and the recycled stack hold data
+        Allocator old = *allocator;
+        uint32 highWater = allocator->m_freeHighWater;
+        uint32 recycledFirst = oldMaxAllocs - highWater;
+        uint32 recycledCount = allocator->m_freeOffset + 1 - recycledFirst;
+        uint32 extraNodes = newMaxAllocs - oldMaxAllocs;
+        carveMetadata(allocator, storage, newMaxAllocs);
+        memcpy(allocator->m_nodes, old.m_nodes,
+               highWater * sizeof(struct _Node));
+        memcpy(allocator->m_binLinks, old.m_binLinks,
+               highWater * sizeof(struct _BinLinks));
+        memcpy(&allocator->m_freeNodes[recycledFirst + extraNodes],
+               &old.m_freeNodes[recycledFirst],
+               recycledCount * sizeof(NodeIndex));
+#ifdef USE_GENERATIONAL_HANDLES
+        memcpy(allocator->m_generations, old.m_generations,
+               allocator->m_generationsUsed * sizeof(uint32));
+#endif
+        free(old.m_metadata);
 
-    // Freelist is a stack. Nodes in inverse order so that [0] pops first.
-    for (uint32 i = 0; i < allocator->m_maxAllocs; i++) {
-        allocator->m_freeNodes[i] = allocator->m_maxAllocs - i - 1;
-        allocator->m_nodes[i].binListNext = NODE_UNUSED;
-        allocator->m_nodes[i].binListPrev = NODE_UNUSED;
-        allocator->m_nodes[i].neighborPrev = NODE_UNUSED;
-        allocator->m_nodes[i].neighborNext = NODE_UNUSED;
+        // The new nodes extend the never used range below the recycled ones
+        allocator->m_freeOffset += extraNodes;
+        allocator->m_maxAllocs = newMaxAllocs;
     }
 
-    // Start state: Whole storage as one big node
-    // Algorithm will split remainders and push them back as smaller nodes
-    insertNodeIntoBin(allocator, allocator->m_size, 0);
+    OffsetType extraSize = newSize - allocator->m_size;
+    if (extraSize > 0) {
+        uint32 tailIndex = allocator->m_tailNode;
+        Node tail = &(allocator->m_nodes[tailIndex]);
+        if (nodeUsed(tail) == false) {
+            // Free tail: extend it. Its bin may change.
+            unlinkNodeFromBin(allocator, tailIndex);
+            setNodeSize(tail, nodeSize(tail) + extraSize);
+            linkNodeIntoBin(allocator, tailIndex);
+        } else {
+            // Used tail: append a new free node after it
+            if (allocator->m_freeOffset == 0)
+                return false;
+            insertReminderAfter(allocator, tailIndex, extraSize);
+        }
+        allocator->m_size = newSize;
+    }
+
+    TRACE(traceEventGrow(allocator->m_traceId, allocator->m_size,
+                         allocator->m_maxAllocs));
+    return true;
+}
+
+void setAllocatorPolicy(Allocator* allocator, const AllocatorPolicy policy) {
+    allocator->m_policy = policy;
 }
 
 void terminateAllocator(Allocator* allocator) {
-    free(allocator->m_nodes);
-    free(allocator->m_freeNodes);
+    if (allocator->m_ownsMetadata)
+        free(allocator->m_metadata);
+    allocator->m_metadata = NULL;
+    allocator->m_nodes = NULL;
+    allocator->m_binLinks = NULL;
+    allocator->m_freeNodes = NULL;
+#ifdef USE_GENERATIONAL_HANDLES
+    allocator->m_generations = NULL;
+#endif
 }
 
-Allocation allocate(Allocator* allocator, const uint32 size) {
-    // Out of allocations?
-    //
-    Allocation res = EmptyAllocation;
-    if (allocator->m_freeOffset == 0) {
-        return res;
+// Finds the lowest non-empty bin that fits an allocation of minBinIndex.
+// Returns BIN_NONE if there's none.
+static uint32 findFreeBin(const Allocator* allocator,
+                          const uint32 minBinIndex) {
+    uint32 minTopBinIndex = minBinIndex >> TOP_BINS_INDEX_SHIFT;
+    uint32 minLeafBinIndex = minBinIndex & LEAF_BINS_INDEX_MASK;
+
+    // Scan the leaf bins of the min top bin. The leaf mask of an unused top
+    // bin is zero, so no need to test the top bit first.
+    LeafBinsMask leafBits = allocator->m_usedBins[minTopBinIndex] &
+                            ~(((LeafBinsMask)1 << minLeafBinIndex) - 1);
+    if (leafBits) {
+        return (minTopBinIndex << TOP_BINS_INDEX_SHIFT) |
+               lowestLeafBin(leafBits);
     }
 
-    // Round up to bin index to ensure that alloc >= bin
-    // Gives us min bin index that fits the size
-    uint32 minBinIndex = uintToFloatRoundUp(size);
+    // Otherwise any top bin from +1. (2 << 31 wraps to 0 for the last bin:
+    // the mask then clears everything.)
+    TopBinsMask topBits = allocator->m_usedBinsTop &
+                          ~(((TopBinsMask)2 << minTopBinIndex) - 1);
+
+    // Out of space?
+    if (topBits == 0)
+        return BIN_NONE;
+
+    // All leaf bins here fit the alloc, since the top bin was rounded up.
+    // NOTE: This search can't fail since at least one leaf bit was set
+    // because the top bit was set.
+    uint32 topBinIndex = lowestTopBin(topBits);
+    uint32 leafBinIndex = lowestLeafBin(allocator->m_usedBins[topBinIndex]);
+    return (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex;
+}
 
-    uint32 minTopBinIndex = minBinIndex >> TOP_BINS_INDEX_SHIFT;
-    uint32 minLeafBinIndex = minBinIndex & LEAF_BINS_INDEX_MASK;
+// Inserts a free node of reminderSize elements directly after the node
+static void insertReminderAfter(Allocator* allocator,
+                                const uint32 nodeIndex,
+                                const OffsetType reminderSize) {
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    uint32 newNodeIndex = insertNodeIntoBin(
+        allocator, reminderSize, node->dataOffset + nodeSize(node));
+    INSTRUMENT(allocator->m_stats.splits++);
+
+    // Link nodes next to each other so that we can merge them later if both
+    // are free And update the old next neighbor to point to the new node
+    // (in middle)
+    if (node->neighborNext != NODE_UNUSED) {
+        allocator->m_nodes[node->neighborNext].neighborPrev = newNodeIndex;
+    } else {
+        allocator->m_tailNode = newNodeIndex;
+    }
+    allocator->m_nodes[newNodeIndex].neighborPrev = nodeIndex;
+    allocator->m_nodes[newNodeIndex].neighborNext = node->neighborNext;
+    node->neighborNext = newNodeIndex;
+}
 
-    uint32 topBinIndex = minTopBinIndex;
-    uint32 leafBinIndex = NO_SPACE;
+// Splits off the first paddingSize elements of the node as a free node
+// directly before it. The node itself moves forward by paddingSize.
+static void insertPaddingBefore(Allocator* allocator,
+                                const uint32 nodeIndex,
+                                const OffsetType paddingSize) {
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    uint32 newNodeIndex =
+        insertNodeIntoBin(allocator, paddingSize, node->dataOffset);
+    INSTRUMENT(allocator->m_stats.splits++);
 
-    // If top bin exists, scan its leaf bin. This can fail (NO_SPACE).
-    if (allocator->m_usedBinsTop & (1 << topBinIndex)) {
-        leafBinIndex = findLowestSetBitAfter(allocator->m_usedBins[topBinIndex],
-                                             minLeafBinIndex);
+    if (node->neighborPrev != NODE_UNUSED) {
+        allocator->m_nodes[node->neighborPrev].neighborNext = newNodeIndex;
+    } else {
+        allocator->m_headNode = newNodeIndex;
     }
+    allocator->m_nodes[newNodeIndex].neighborPrev = node->neighborPrev;
+    allocator->m_nodes[newNodeIndex].neighborNext = nodeIndex;
+    node->neighborPrev = newNodeIndex;
 
-    // If we didn't find space in top bin, we search top bin from +1
-    if (leafBinIndex == NO_SPACE) {
-        topBinIndex =
-            findLowestSetBitAfter(allocator->m_usedBinsTop, minTopBinIndex + 1);
+    node->dataOffset += paddingSize;
+    setNodeSize(node, nodeSize(node) - paddingSize);
+}
 
-        // Out of space?
-        if (topBinIndex == NO_SPACE) {
-            return res;
-        }
+#ifdef USE_ALLOCATOR_TRACE
+static inline void traceAllocate(const Allocator* allocator,
+                                 const OffsetType size,
+                                 const AllocationLifetime lifetime,
+                                 const Allocation allocation) {
+    if (lifetime == ALLOCATION_LIFETIME_TRANSIENT)
+        traceEventAllocateTransient(allocator->m_traceId, size, allocation);
+    else
+        traceEventAllocate(allocator->m_traceId, size, 1, allocation);
+}
+#endif
+
+// Marks size elements of an unlinked free node used and pushes the reminder
+// back to a lower bin. Long lived ranges take the start of the node (the
+// reminder goes after them), transient ranges take the end (the reminder
+// goes before them). Returns the reminder size.
+static OffsetType splitAllocatedNode(Allocator* allocator,
+                                     const uint32 nodeIndex,
+                                     const OffsetType size,
+                                     const AllocationLifetime lifetime) {
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    OffsetType reminderSize = nodeSize(node) - size;
+    setNodeUsed(node, true);
+    if (reminderSize == 0)
+        return 0;
 
-        // All leaf bins here fit the alloc, since the top bin was rounded up.
-        // Start leaf search from bit 0. NOTE: This search can't fail since at
-        // least one leaf bit was set because the top bit was set.
-        leafBinIndex = tzcnt_nonzero(allocator->m_usedBins[topBinIndex]);
+    if (lifetime == ALLOCATION_LIFETIME_TRANSIENT) {
+        insertPaddingBefore(allocator, nodeIndex, reminderSize);
+    } else {
+        setNodeSize(node, size);
+        insertReminderAfter(allocator, nodeIndex, reminderSize);
     }
+    return reminderSize;
+}
 
-    uint32 binIndex = (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex;
+// Pops the top node of a non-empty bin, marks size elements used and pushes
+// the reminder back to a lower bin. Returns the reminder size.
+static OffsetType allocateFromBin(Allocator* allocator,
+                                  const uint32 binIndex,
+                                  const OffsetType size,
+                                  const AllocationLifetime lifetime,
+                                  Allocation* res) {
+    uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
+    uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
 
     // Pop the top node of the bin. Bin top = node.next.
     uint32 nodeIndex = allocator->m_binIndices[binIndex];
     Node node = &(allocator->m_nodes[nodeIndex]);
-    uint32 nodeTotalSize = node->dataSize;
-    node->dataSize = size;
-    node->used = true;
-    allocator->m_binIndices[binIndex] = node->binListNext;
-    if (node->binListNext != NODE_UNUSED)
-        allocator->m_nodes[node->binListNext].binListPrev = NODE_UNUSED;
+    BinLinks links = &(allocator->m_binLinks[nodeIndex]);
+    OffsetType nodeTotalSize = nodeSize(node);
+    allocator->m_binIndices[binIndex] = links->binListNext;
+    if (links->binListNext != NODE_UNUSED)
+        allocator->m_binLinks[links->binListNext].binListPrev = NODE_UNUSED;
+    allocator->m_binCounts[binIndex]--;
     allocator->m_freeStorage -= nodeTotalSize;
 #ifdef DEBUG_VERBOSE
-    printf("Free storage: %u (-%u) (allocate)\n", allocator->m_freeStorage,
-           nodeTotalSize);
+    printf("Free storage: %llu (-%llu) (allocate)\n",
+           (uint64)allocator->m_freeStorage, (uint64)nodeTotalSize);
 #endif
 
     // Bin empty?
     if (allocator->m_binIndices[binIndex] == NODE_UNUSED) {
         // Remove a leaf bin mask bit
-        allocator->m_usedBins[topBinIndex] &= ~(1 << leafBinIndex);
+        allocator->m_usedBins[topBinIndex] &=
+            ~((LeafBinsMask)1 << leafBinIndex);
 
         // All leaf bins empty?
         if (allocator->m_usedBins[topBinIndex] == 0) {
             // Remove a top bin mask bit
-            allocator->m_usedBinsTop &= ~(1 << topBinIndex);
+            allocator->m_usedBinsTop &= ~((TopBinsMask)1 << topBinIndex);
         }
     }
 
     // Push back reminder N elements to a lower bin
-    uint32 reminderSize = nodeTotalSize - size;
-    if (reminderSize > 0) {
-        uint32 newNodeIndex =
-            insertNodeIntoBin(allocator, reminderSize, node->dataOffset + size);
-
-        // Link nodes next to each other so that we can merge them later if both
-        // are free And update the old next neighbor to point to the new node
-        // (in middle)
-        if (node->neighborNext != NODE_UNUSED) {
-            allocator->m_nodes[node->neighborNext].neighborPrev = newNodeIndex;
-        }
-        allocator->m_nodes[newNodeIndex].neighborPrev = nodeIndex;
-        allocator->m_nodes[newNodeIndex].neighborNext = node->neighborNext;
-        node->neighborNext = newNodeIndex;
-    }
+    OffsetType reminderSize =
+        splitAllocatedNode(allocator, nodeIndex, size, lifetime);
 
-    res.offset = node->dataOffset;
-    res.metadata = nodeIndex;
+    res->offset = node->dataOffset;
+    res->metadata = nodeIndex;
+    setHandleGeneration(allocator, res);
+    INSTRUMENT(recordAllocate(allocator, *res, size));
+    TRACE(traceAllocate(allocator, size, lifetime, *res));
 
-    return res;
+    return reminderSize;
 }
 
-void freeAllocation(Allocator* allocator, Allocation allocation) {
-    ASSERT(allocation.metadata != NO_SPACE);
-    if (!allocator->m_nodes)
-        return;
+// Cheap check for the allocate paths: a relaxed load, no atomic RMW unless
+// another thread has queued frees
+static inline void drainRemoteFreesIfAny(Allocator* allocator) {
+    if (atomicLoad(&allocator->m_remoteFrees) != 0)
+        drainRemoteFrees(allocator);
+}
 
-    uint32 nodeIndex = allocation.metadata;
-    Node node = &(allocator->m_nodes[nodeIndex]);
+// Best fit: sizes between two bin sizes round up to the next bin, but the
+// round down bin may hold a node that fits. Probes the head of its list and
+// returns the smallest fitting node, or NODE_UNUSED.
+static uint32 findBestFitNode(const Allocator* allocator,
+                              const OffsetType size) {
+    uint32 binIndex = uintToFloatRoundDown(size);
+    if (floatToUint(binIndex) == size)
+        return NODE_UNUSED;
 
-    // Double delete check
-    ASSERT(node.used == true);
+    uint32 bestIndex = NODE_UNUSED;
+    OffsetType bestSize = NO_SPACE;
+    uint32 nodeIndex = allocator->m_binIndices[binIndex];
+    for (uint32 i = 0; i < BEST_FIT_PROBE_COUNT && nodeIndex != NODE_UNUSED;
+         i++) {
+        OffsetType candidateSize = nodeSize(&allocator->m_nodes[nodeIndex]);
+        if (candidateSize >= size && candidateSize < bestSize) {
+            bestIndex = nodeIndex;
+            bestSize = candidateSize;
+            if (candidateSize == size)
+                break;
+        }
+        nodeIndex = allocator->m_binLinks[nodeIndex].binListNext;
+    }
+    return bestIndex;
+}
 
-    // Merge with neighbors...
-    uint32 offset = node->dataOffset;
-    uint32 size = node->dataSize;
+static Allocation allocateWithLifetime(Allocator* allocator,
+                                       const OffsetType size,
+                                       const AllocationLifetime lifetime) {
+    drainRemoteFreesIfAny(allocator);
 
-    if ((node->neighborPrev != NODE_UNUSED) &&
-        (allocator->m_nodes[node->neighborPrev].used == false)) {
-        // Previous (contiguous) free node: Change offset to previous node
-        // offset. Sum sizes
-        Node prevNode = &(allocator->m_nodes[node->neighborPrev]);
-        offset = prevNode->dataOffset;
-        size += prevNode->dataSize;
+    // Out of allocations?
+    //
+    Allocation res = EmptyAllocation;
+    if (allocator->m_freeOffset == 0) {
+        INSTRUMENT(recordFailure(allocator, size));
+        TRACE(traceAllocate(allocator, size, lifetime, res));
+        return res;
+    }
 
-        // Remove node from the bin linked list and put it in the freelist
-        removeNodeFromBin(allocator, node->neighborPrev);
+    if (allocator->m_policy == ALLOCATOR_POLICY_BEST_FIT) {
+        uint32 nodeIndex = findBestFitNode(allocator, size);
+        if (nodeIndex != NODE_UNUSED) {
+            unlinkNodeFromBin(allocator, nodeIndex);
+            splitAllocatedNode(allocator, nodeIndex, size, lifetime);
+
+            res.offset = allocator->m_nodes[nodeIndex].dataOffset;
+            res.metadata = nodeIndex;
+            setHandleGeneration(allocator, &res);
+            INSTRUMENT(recordAllocate(allocator, res, size));
+            TRACE(traceAllocate(allocator, size, lifetime, res));
+            return res;
+        }
+    }
 
-        ASSERT(prevNode.neighborNext == nodeIndex);
-        node->neighborPrev = prevNode->neighborPrev;
+    // Round up to bin index to ensure that alloc >= bin
+    // Gives us min bin index that fits the size
+    uint32 binIndex = findFreeBin(allocator, uintToFloatRoundUp(size));
+    if (binIndex == BIN_NONE) {
+        INSTRUMENT(recordFailure(allocator, size));
+        TRACE(traceAllocate(allocator, size, lifetime, res));
+        return res;
     }
 
-    if ((node->neighborNext != NODE_UNUSED) &&
-        (allocator->m_nodes[node->neighborNext].used == false)) {
-        // Next (contiguous) free node: Offset remains the same. Sum sizes.
-        Node nextNode = &(allocator->m_nodes[node->neighborNext]);
-        size += nextNode->dataSize;
+    allocateFromBin(allocator, binIndex, size, lifetime, &res);
+    return res;
+}
 
-        // Remove node from the bin linked list and put it in the freelist
-        removeNodeFromBin(allocator, node->neighborNext);
+Allocation allocate(Allocator* allocator, const OffsetType size) {
+    return allocateWithLifetime(allocator, size, ALLOCATION_LIFETIME_LONG);
+}
 
-        ASSERT(nextNode->neighborPrev == nodeIndex);
-        node->neighborNext = nextNode->neighborNext;
-    }
+Allocation allocateWithHint(Allocator* allocator,
+                            const OffsetType size,
+                            const AllocationLifetime lifetime) {
+    return allocateWithLifetime(allocator, size, lifetime);
+}
 
-    uint32 neighborNext = node->neighborNext;
-    uint32 neighborPrev = node->neighborPrev;
+Allocation allocateAligned(Allocator* allocator,
+                           const OffsetType size,
+                           const OffsetType alignment) {
+    ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    if (alignment <= 1) {
+        return allocate(allocator, size);
+    }
 
-    // Insert the removed node to freelist
-#ifdef DEBUG_VERBOSE
-    printf("Putting node %u into freelist[%u] (free)\n", nodeIndex,
-           m_freeOffset + 1);
-#endif
-    allocator->m_freeNodes[++allocator->m_freeOffset] = nodeIndex;
+    drainRemoteFreesIfAny(allocator);
 
-    // Insert the (combined) free node to bin
-    uint32 combinedNodeIndex = insertNodeIntoBin(allocator, size, offset);
+    // Out of allocations? Padding and reminder may both need a node.
+    Allocation res = EmptyAllocation;
+    if (allocator->m_freeOffset <= 1) {
+        INSTRUMENT(recordFailure(allocator, size));
+        TRACE(traceEventAllocate(allocator->m_traceId, size, alignment,
+                                 res));
+        return res;
+    }
 
-    // Connect neighbors with the new combined node
-    if (neighborNext != NODE_UNUSED) {
-        allocator->m_nodes[combinedNodeIndex].neighborNext = neighborNext;
-        allocator->m_nodes[neighborNext].neighborPrev = combinedNodeIndex;
+    // The first fitting bin usually has a node that fits after alignment.
+    // Otherwise search the bins that are guaranteed to fit the worst case
+    // padding. Only the tested node is split, no space is lost.
+    uint32 nodeIndex = NODE_UNUSED;
+    OffsetType paddingSize = 0;
+
+    uint32 binIndex = findFreeBin(allocator, uintToFloatRoundUp(size));
+    if (binIndex == BIN_NONE) {
+        INSTRUMENT(recordFailure(allocator, size));
+        TRACE(traceEventAllocate(allocator->m_traceId, size, alignment,
+                                 res));
+        return res;
     }
-    if (neighborPrev != NODE_UNUSED) {
-        allocator->m_nodes[combinedNodeIndex].neighborPrev = neighborPrev;
-        allocator->m_nodes[neighborPrev].neighborNext = combinedNodeIndex;
+    for (uint32 pass = 0; pass < 2; pass++) {
+        uint32 candidate = allocator->m_binIndices[binIndex];
+        Node node = &(allocator->m_nodes[candidate]);
+        OffsetType alignedOffset =
+            (node->dataOffset + alignment - 1) & ~(alignment - 1);
+        if (nodeSize(node) >= alignedOffset - node->dataOffset + size) {
+            nodeIndex = candidate;
+            paddingSize = alignedOffset - node->dataOffset;
+            break;
+        }
+
+        binIndex = findFreeBin(allocator,
+                               uintToFloatRoundUp(size + alignment - 1));
+        if (binIndex == BIN_NONE) {
+            INSTRUMENT(recordFailure(allocator, size));
+            TRACE(traceEventAllocate(allocator->m_traceId, size, alignment,
+                                     res));
+            return res;
+        }
     }
-}
+    ASSERT(nodeIndex != NODE_UNUSED);
 
-static uint32 insertNodeIntoBin(Allocator* allocator,
-                                const uint32 size,
-                                const uint32 dataOffset) {
-    // Round down to bin index to ensure that bin >= alloc
-    uint32 binIndex = uintToFloatRoundDown(size);
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    unlinkNodeFromBin(allocator, nodeIndex);
 
-    uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
-    uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
+    if (paddingSize > 0) {
+        insertPaddingBefore(allocator, nodeIndex, paddingSize);
+    }
+
+    OffsetType reminderSize = nodeSize(node) - size;
+    setNodeSize(node, size);
+    setNodeUsed(node, true);
+    if (reminderSize > 0) {
+        insertReminderAfter(allocator, nodeIndex, reminderSize);
+    }
+
+    res.offset = node->dataOffset;
+    res.metadata = nodeIndex;
+    setHandleGeneration(allocator, &res);
+    INSTRUMENT(recordAllocate(allocator, res, size));
+    TRACE(traceEventAllocate(allocator->m_traceId, size, alignment, res));
+    return res;
+}
+
+uint32 allocateBatch(Allocator* allocator,
+                     const OffsetType* sizes,
+                     const uint32 count,
+                     Allocation* allocations) {
+    uint32 numAllocated = 0;
+    drainRemoteFreesIfAny(allocator);
+
+    // Bin search state of the previous request. Reused while the sizes repeat.
+    OffsetType prevSize = NO_SPACE;
+    uint32 minBinIndex = BIN_NONE;
+    uint32 binIndex = BIN_NONE;
+
+    for (uint32 i = 0; i < count; i++) {
+        Allocation res = EmptyAllocation;
+        OffsetType size = sizes[i];
+
+        if (allocator->m_freeOffset == 0) {
+            INSTRUMENT(recordFailure(allocator, size));
+            TRACE(traceEventAllocate(allocator->m_traceId, size, 1, res));
+            allocations[i] = res;
+            continue;
+        }
+
+        if (size != prevSize) {
+            prevSize = size;
+            minBinIndex = uintToFloatRoundUp(size);
+            binIndex = findFreeBin(allocator, minBinIndex);
+        } else if (binIndex != BIN_NONE &&
+                   allocator->m_binIndices[binIndex] == NODE_UNUSED) {
+            // Previous pop emptied the bin: search again from the min bin
+            binIndex = findFreeBin(allocator, minBinIndex);
+        }
+
+        if (binIndex == BIN_NONE) {
+            INSTRUMENT(recordFailure(allocator, size));
+            TRACE(traceEventAllocate(allocator->m_traceId, size, 1, res));
+            allocations[i] = res;
+            continue;
+        }
+
+        OffsetType reminderSize =
+            allocateFromBin(allocator, binIndex, size,
+                            ALLOCATION_LIFETIME_LONG, &res);
+        allocations[i] = res;
+        numAllocated++;
+
+        // The bins in [minBinIndex, binIndex) were empty. Only the reminder
+        // could have landed there, so it becomes the lowest fitting bin.
+        if (reminderSize > 0) {
+            uint32 reminderBinIndex = uintToFloatRoundDown(reminderSize);
+            if (reminderBinIndex >= minBinIndex && reminderBinIndex < binIndex)
+                binIndex = reminderBinIndex;
+        }
+    }
+
+    return numAllocated;
+}
+
+// Pending nodes (freed, not yet merged) are marked with a self-referencing
+// binListPrev. A node linked into a bin can never point at itself.
+static inline void markNodePending(Allocator* allocator,
+                                   const uint32 nodeIndex) {
+    Node node = &(allocator->m_nodes[nodeIndex]);
+
+    // Double delete check
+    ASSERT(nodeUsed(node) == true);
+    INSTRUMENT(recordFree(allocator, nodeIndex));
+    TRACE(traceEventFree(allocator->m_traceId, nodeIndex));
+    bumpNodeGeneration(allocator, nodeIndex);
+
+    setNodeUsed(node, false);
+    allocator->m_binLinks[nodeIndex].binListPrev = nodeIndex;
+}
+
+static inline bool isNodePending(const Allocator* allocator,
+                                 const uint32 nodeIndex) {
+    return !nodeUsed(&allocator->m_nodes[nodeIndex]) &&
+           allocator->m_binLinks[nodeIndex].binListPrev == nodeIndex;
+}
+
+// Merges a pending node with all contiguous free and pending neighbors and
+// inserts the combined range into a bin. The pending node itself becomes the
+// combined node, all merged neighbors are returned to the freelist.
+static void mergePendingNode(Allocator* allocator, const uint32 nodeIndex) {
+    Node node = &(allocator->m_nodes[nodeIndex]);
+
+    // Merge with neighbors...
+    OffsetType offset = node->dataOffset;
+    OffsetType size = nodeSize(node);
+
+    uint32 neighborPrev = node->neighborPrev;
+    while ((neighborPrev != NODE_UNUSED) &&
+           (nodeUsed(&allocator->m_nodes[neighborPrev]) == false)) {
+        // Previous (contiguous) free node: Change offset to previous node
+        // offset. Sum sizes
+        Node prevNode = &(allocator->m_nodes[neighborPrev]);
+        offset = prevNode->dataOffset;
+        size += nodeSize(prevNode);
+
+        INSTRUMENT(allocator->m_stats.merges++);
+        if (isNodePending(allocator, neighborPrev)) {
+            // Not in any bin yet: put it directly in the freelist
+            allocator->m_binLinks[neighborPrev].binListPrev = NODE_UNUSED;
+            allocator->m_freeNodes[++allocator->m_freeOffset] = neighborPrev;
+        } else {
+            // Remove node from the bin linked list and put it in the freelist
+            removeNodeFromBin(allocator, neighborPrev);
+        }
+
+        neighborPrev = prevNode->neighborPrev;
+    }
+
+    uint32 neighborNext = node->neighborNext;
+    while ((neighborNext != NODE_UNUSED) &&
+           (nodeUsed(&allocator->m_nodes[neighborNext]) == false)) {
+        // Next (contiguous) free node: Offset remains the same. Sum sizes.
+        Node nextNode = &(allocator->m_nodes[neighborNext]);
+        size += nodeSize(nextNode);
+
+        INSTRUMENT(allocator->m_stats.merges++);
+        if (isNodePending(allocator, neighborNext)) {
+            allocator->m_binLinks[neighborNext].binListPrev = NODE_UNUSED;
+            allocator->m_freeNodes[++allocator->m_freeOffset] = neighborNext;
+        } else {
+            removeNodeFromBin(allocator, neighborNext);
+        }
+
+        neighborNext = nextNode->neighborNext;
+    }
+
+    // Insert the (combined) free node to bin
+    node->dataOffset = offset;
+    setNodeSize(node, size);
+    linkNodeIntoBin(allocator, nodeIndex);
+
+    // Connect neighbors with the combined node
+    node->neighborNext = neighborNext;
+    node->neighborPrev = neighborPrev;
+    if (neighborNext != NODE_UNUSED) {
+        allocator->m_nodes[neighborNext].neighborPrev = nodeIndex;
+    } else {
+        allocator->m_tailNode = nodeIndex;
+    }
+    if (neighborPrev != NODE_UNUSED) {
+        allocator->m_nodes[neighborPrev].neighborNext = nodeIndex;
+    } else {
+        allocator->m_headNode = nodeIndex;
+    }
+}
+
+bool allocationValid(const Allocator* allocator, const Allocation allocation) {
+    // Nodes above the high water mark haven't been handed out since reset
+    if (!allocator->m_nodes ||
+        allocation.metadata >= allocator->m_freeHighWater)
+        return false;
+    if (!nodeUsed(&allocator->m_nodes[allocation.metadata]))
+        return false;
+#ifdef USE_GENERATIONAL_HANDLES
+    return allocator->m_generations[allocation.metadata] ==
+           allocation.generation;
+#else
+    return true;
+#endif
+}
+
+// Generational handles: stale and double frees are rejected (counted by the
+// instrumentation). Otherwise they are the caller's bug, caught in DEBUG.
+static inline bool acceptFree(Allocator* allocator,
+                              const Allocation allocation) {
+#ifdef USE_GENERATIONAL_HANDLES
+    if (!allocationValid(allocator, allocation)) {
+        INSTRUMENT(allocator->m_stats.rejectedFrees++);
+        return false;
+    }
+#else
+    (void)allocator;
+    (void)allocation;
+    ASSERT(allocation.metadata != NODE_UNUSED);
+#endif
+    return true;
+}
+
+void freeAllocation(Allocator* allocator, Allocation allocation) {
+    if (!allocator->m_nodes)
+        return;
+    if (!acceptFree(allocator, allocation))
+        return;
+
+    uint32 nodeIndex = allocation.metadata;
+    markNodePending(allocator, nodeIndex);
+    mergePendingNode(allocator, nodeIndex);
+}
+
+void freeAllocationRemote(Allocator* allocator, Allocation allocation) {
+    // NOTE: Concurrent double frees of one handle from two threads can race
+    // past the generation check. Queued nodes stay used until drained.
+    if (!acceptFree(allocator, allocation))
+        return;
+    bumpNodeGeneration(allocator, allocation.metadata);
+
+    // The bin list links of a used node are unused: borrow binListNext as the
+    // stack link. The owner never touches them until the node is drained.
+    uint32 nodeIndex = allocation.metadata;
+    long head;
+    do {
+        head = atomicLoad(&allocator->m_remoteFrees);
+        allocator->m_binLinks[nodeIndex].binListNext =
+            (NodeIndex)(head ? (uint32)head - 1 : NODE_UNUSED);
+    } while (!atomicCompareExchange(&allocator->m_remoteFrees, head,
+                                    (long)(nodeIndex + 1)));
+}
+
+// Marks a chain of used nodes (linked through binListNext) pending.
+// Returns the chain length.
+static uint32 markNodeChainPending(Allocator* allocator, const uint32 first) {
+    uint32 count = 0;
+    for (uint32 nodeIndex = first; nodeIndex != NODE_UNUSED;
+         nodeIndex = allocator->m_binLinks[nodeIndex].binListNext) {
+        markNodePending(allocator, nodeIndex);
+        count++;
+    }
+    return count;
+}
+
+// Merges the still pending nodes of a chain marked by markNodeChainPending.
+// Nodes absorbed by earlier merges keep their chain link intact.
+static void mergeNodeChain(Allocator* allocator, const uint32 first) {
+    uint32 nodeIndex = first;
+    while (nodeIndex != NODE_UNUSED) {
+        // Merging links the node into a bin, which overwrites the chain link
+        uint32 next = allocator->m_binLinks[nodeIndex].binListNext;
+        if (isNodePending(allocator, nodeIndex)) {
+            mergePendingNode(allocator, nodeIndex);
+        }
+        nodeIndex = next;
+    }
+}
+
+uint32 drainRemoteFrees(Allocator* allocator) {
+    long head = atomicExchange(&allocator->m_remoteFrees, 0);
+    if (head == 0)
+        return 0;
+
+    // Same as freeBatch: mark everything, then merge each contiguous run once
+    uint32 first = (uint32)head - 1;
+    uint32 count = markNodeChainPending(allocator, first);
+    mergeNodeChain(allocator, first);
+    return count;
+}
+
+void freeAllocationDeferred(Allocator* allocator,
+                            Allocation allocation,
+                            const uint64 fence) {
+    if (!acceptFree(allocator, allocation))
+        return;
+    ASSERT(nodeUsed(&allocator->m_nodes[allocation.metadata]) == true);
+
+    // The node stays used until retired, but its handles are dead now
+    bumpNodeGeneration(allocator, allocation.metadata);
+
+    // Newest group: same fence (or an older one, which is safe to retire
+    // later). A full ring also folds the new fence into the newest group.
+    DeferredFreeGroup* group = NULL;
+    if (allocator->m_deferredCount > 0) {
+        uint32 newest = (allocator->m_deferredFirst +
+                         allocator->m_deferredCount - 1) %
+                        DEFERRED_FREE_GROUPS;
+        group = &allocator->m_deferredGroups[newest];
+        if (fence > group->fence) {
+            if (allocator->m_deferredCount < DEFERRED_FREE_GROUPS) {
+                group = NULL;
+            } else {
+                group->fence = fence;
+            }
+        }
+    }
+
+    if (group == NULL) {
+        uint32 slot = (allocator->m_deferredFirst +
+                       allocator->m_deferredCount++) %
+                      DEFERRED_FREE_GROUPS;
+        group = &allocator->m_deferredGroups[slot];
+        group->fence = fence;
+        group->head = NODE_UNUSED;
+    }
+
+    // Used node: its bin list links are free to chain the group
+    uint32 nodeIndex = allocation.metadata;
+    allocator->m_binLinks[nodeIndex].binListNext = group->head;
+    group->head = nodeIndex;
+}
+
+uint32 retireUpTo(Allocator* allocator, const uint64 completedFence) {
+    // Mark every retired group first, so that ranges freed in different
+    // frames are still merged once
+    uint32 first = allocator->m_deferredFirst;
+    uint32 numGroups = 0;
+    uint32 count = 0;
+    while (numGroups < allocator->m_deferredCount) {
+        DeferredFreeGroup* group =
+            &allocator->m_deferredGroups[(first + numGroups) %
+                                         DEFERRED_FREE_GROUPS];
+        if (group->fence > completedFence)
+            break;
+        count += markNodeChainPending(allocator, group->head);
+        numGroups++;
+    }
+
+    for (uint32 i = 0; i < numGroups; i++) {
+        mergeNodeChain(allocator,
+                       allocator->m_deferredGroups[(first + i) %
+                                                   DEFERRED_FREE_GROUPS]
+                           .head);
+    }
+
+    allocator->m_deferredFirst = (first + numGroups) % DEFERRED_FREE_GROUPS;
+    allocator->m_deferredCount -= numGroups;
+    return count;
+}
+
+static ReallocateResult reallocateNode(Allocator* allocator,
+                                       Allocation* allocation,
+                                       const OffsetType newSize) {
+    ASSERT(allocation->metadata != NODE_UNUSED);
+#ifdef USE_GENERATIONAL_HANDLES
+    if (!allocationValid(allocator, *allocation))
+        return REALLOCATE_FAILED;
+#endif
+
+    uint32 nodeIndex = allocation->metadata;
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    ASSERT(nodeUsed(node) == true);
+
+    OffsetType size = nodeSize(node);
+    uint32 nextIndex = node->neighborNext;
+    bool nextFree = (nextIndex != NODE_UNUSED) &&
+                    (nodeUsed(&allocator->m_nodes[nextIndex]) == false);
+
+    if (newSize <= size) {
+        OffsetType tailSize = size - newSize;
+        if (tailSize == 0) {
+            return REALLOCATE_IN_PLACE;
+        }
+
+        if (nextFree) {
+            // Shrink: Grow the next free node backwards. Its bin may change.
+            Node nextNode = &(allocator->m_nodes[nextIndex]);
+            unlinkNodeFromBin(allocator, nextIndex);
+            nextNode->dataOffset -= tailSize;
+            setNodeSize(nextNode, nodeSize(nextNode) + tailSize);
+            linkNodeIntoBin(allocator, nextIndex);
+            setNodeSize(node, newSize);
+        } else if (allocator->m_freeOffset > 0) {
+            // Shrink: Push the tail back to a bin as a new free node
+            setNodeSize(node, newSize);
+            insertReminderAfter(allocator, nodeIndex, tailSize);
+        }
+        // NOTE: Out of nodes: keep the old (larger) size, still in place
+        return REALLOCATE_IN_PLACE;
+    }
+
+    OffsetType growSize = newSize - size;
+    if (nextFree && nodeSize(&allocator->m_nodes[nextIndex]) >= growSize) {
+        // Grow: Absorb the head of the next free node
+        Node nextNode = &(allocator->m_nodes[nextIndex]);
+        OffsetType nextSize = nodeSize(nextNode);
+        if (nextSize == growSize) {
+            // Whole node absorbed: unlink it from neighbors and recycle it
+            removeNodeFromBin(allocator, nextIndex);
+            node->neighborNext = nextNode->neighborNext;
+            if (node->neighborNext != NODE_UNUSED) {
+                allocator->m_nodes[node->neighborNext].neighborPrev =
+                    nodeIndex;
+            } else {
+                allocator->m_tailNode = nodeIndex;
+            }
+        } else {
+            unlinkNodeFromBin(allocator, nextIndex);
+            nextNode->dataOffset += growSize;
+            setNodeSize(nextNode, nextSize - growSize);
+            linkNodeIntoBin(allocator, nextIndex);
+        }
+        setNodeSize(node, newSize);
+        return REALLOCATE_IN_PLACE;
+    }
+
+    // Move: New allocation first, so the old range stays intact for the copy.
+    // Traced as a single reallocate event, not as an allocate and a free.
+#ifdef USE_ALLOCATOR_TRACE
+    uint32 traceId = allocator->m_traceId;
+    allocator->m_traceId = 0;
+#endif
+    Allocation moved = allocate(allocator, newSize);
+    if (moved.offset != NO_SPACE)
+        freeAllocation(allocator, *allocation);
+#ifdef USE_ALLOCATOR_TRACE
+    allocator->m_traceId = traceId;
+#endif
+    if (moved.offset == NO_SPACE) {
+        return REALLOCATE_FAILED;
+    }
+    *allocation = moved;
+    return REALLOCATE_MOVED;
+}
+
+ReallocateResult reallocate(Allocator* allocator,
+                            Allocation* allocation,
+                            const OffsetType newSize) {
+    TRACE(uint32 nodeIndex = allocation->metadata);
+    ReallocateResult result = reallocateNode(allocator, allocation, newSize);
+    TRACE(traceEventReallocate(allocator->m_traceId, nodeIndex, newSize,
+                               *allocation, result));
+    return result;
+}
+
+void freeBatch(Allocator* allocator,
+               const Allocation* allocations,
+               const uint32 count) {
+    if (!allocator->m_nodes)
+        return;
+
+    // Mark everything first, so that runs of contiguous freed allocations
+    // are merged into single bin insert instead of a remove+insert per node
+    for (uint32 i = 0; i < count; i++) {
+        if (acceptFree(allocator, allocations[i]))
+            markNodePending(allocator, allocations[i].metadata);
+    }
+
+    // Nodes already absorbed by an earlier merge are no longer pending.
+    // (Rejected entries may point anywhere: only pending nodes are touched.)
+    for (uint32 i = 0; i < count; i++) {
+        uint32 nodeIndex = allocations[i].metadata;
+        if (nodeIndex < allocator->m_freeHighWater &&
+            isNodePending(allocator, nodeIndex)) {
+            mergePendingNode(allocator, nodeIndex);
+        }
+    }
+}
+
+uint32 defragmentStep(Allocator* allocator,
+                      DefragMove* moves,
+                      const uint32 maxMoves) {
+    // Find the first free node in address order. Nodes before the cursor
+    // are used, it may have been allocated since the last call.
+    uint32 freeIndex = allocator->m_defragNode != NODE_UNUSED
+                           ? allocator->m_defragNode
+                           : allocator->m_headNode;
+    while (freeIndex != NODE_UNUSED &&
+           nodeUsed(&allocator->m_nodes[freeIndex])) {
+        freeIndex = allocator->m_nodes[freeIndex].neighborNext;
+    }
+    allocator->m_defragNode = freeIndex;
+    if (freeIndex == NODE_UNUSED)
+        return 0;
+
+    // Slide the used nodes after it down one by one. The free node bubbles
+    // up, keeping its size (and bin), and absorbs the free nodes it meets.
+    Node freeNode = &(allocator->m_nodes[freeIndex]);
+    uint32 numMoves = 0;
+    while (numMoves < maxMoves && freeNode->neighborNext != NODE_UNUSED) {
+        uint32 usedIndex = freeNode->neighborNext;
+        Node usedNode = &(allocator->m_nodes[usedIndex]);
+        ASSERT(nodeUsed(usedNode) == true);
+
+        DefragMove move = {.metadata = usedIndex,
+                           .oldOffset = usedNode->dataOffset,
+                           .newOffset = freeNode->dataOffset,
+                           .size = nodeSize(usedNode)};
+        moves[numMoves++] = move;
+
+        usedNode->dataOffset = freeNode->dataOffset;
+        freeNode->dataOffset += nodeSize(usedNode);
+
+        // Swap neighbor order: prev <-> free <-> used <-> next
+        // becomes prev <-> used <-> free <-> next
+        uint32 prevIndex = freeNode->neighborPrev;
+        uint32 nextIndex = usedNode->neighborNext;
+        usedNode->neighborPrev = prevIndex;
+        usedNode->neighborNext = freeIndex;
+        freeNode->neighborPrev = usedIndex;
+        freeNode->neighborNext = nextIndex;
+        if (prevIndex != NODE_UNUSED) {
+            allocator->m_nodes[prevIndex].neighborNext = usedIndex;
+        } else {
+            allocator->m_headNode = usedIndex;
+        }
+        if (nextIndex != NODE_UNUSED) {
+            allocator->m_nodes[nextIndex].neighborPrev = freeIndex;
+        } else {
+            allocator->m_tailNode = freeIndex;
+            break;
+        }
+
+        // Next node free? Merge it. The combined node may change bin.
+        Node nextNode = &(allocator->m_nodes[nextIndex]);
+        if (nodeUsed(nextNode) == false) {
+            unlinkNodeFromBin(allocator, freeIndex);
+            removeNodeFromBin(allocator, nextIndex);
+            setNodeSize(freeNode, nodeSize(freeNode) + nodeSize(nextNode));
+            freeNode->neighborNext = nextNode->neighborNext;
+            if (freeNode->neighborNext != NODE_UNUSED) {
+                allocator->m_nodes[freeNode->neighborNext].neighborPrev =
+                    freeIndex;
+            } else {
+                allocator->m_tailNode = freeIndex;
+            }
+            linkNodeIntoBin(allocator, freeIndex);
+        }
+    }
+
+    return numMoves;
+}
+
+// Links a free node on top of its bin linked list (next = old top)
+static void linkNodeIntoBin(Allocator* allocator, const uint32 nodeIndex) {
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    BinLinks links = &(allocator->m_binLinks[nodeIndex]);
+    OffsetType size = nodeSize(node);
+
+    // Free space at or below the defragment cursor: it's the first hole now.
+    // (Equal offset: padding split off before the cursor node.)
+    uint32 defragNode = allocator->m_defragNode;
+    if (defragNode != NODE_UNUSED && defragNode != nodeIndex &&
+        node->dataOffset <= allocator->m_nodes[defragNode].dataOffset) {
+        allocator->m_defragNode = nodeIndex;
+    }
+
+    // Round down to bin index to ensure that bin >= alloc
+    uint32 binIndex = uintToFloatRoundDown(size);
+
+    uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
+    uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
 
     // Bin was empty before?
     if (allocator->m_binIndices[binIndex] == NODE_UNUSED) {
         // Set bin mask bits
-        allocator->m_usedBins[topBinIndex] |= 1 << leafBinIndex;
-        allocator->m_usedBinsTop |= 1 << topBinIndex;
+        allocator->m_usedBins[topBinIndex] |= (LeafBinsMask)1 << leafBinIndex;
+        allocator->m_usedBinsTop |= (TopBinsMask)1 << topBinIndex;
     }
 
-    // Take a freelist node and insert on top of the bin linked list (next = old
-    // top)
     uint32 topNodeIndex = allocator->m_binIndices[binIndex];
-    uint32 nodeIndex = allocator->m_freeNodes[allocator->m_freeOffset--];
-#ifdef DEBUG_VERBOSE
-    printf("Getting node %u from freelist[%u]\n", nodeIndex,
-           allocator->m_freeOffset + 1);
-#endif
-    allocator->m_nodes[nodeIndex].dataOffset = dataOffset;
-    allocator->m_nodes[nodeIndex].dataSize = size;
-    allocator->m_nodes[nodeIndex].binListNext = topNodeIndex;
-    allocator->m_nodes[nodeIndex].binListPrev = NODE_UNUSED;
-    allocator->m_nodes[nodeIndex].neighborPrev = NODE_UNUSED;
-    allocator->m_nodes[nodeIndex].neighborNext = NODE_UNUSED;
-    allocator->m_nodes[nodeIndex].used = false;
+    links->binListNext = topNodeIndex;
+    links->binListPrev = NODE_UNUSED;
+    setNodeUsed(node, false);
 
     if (topNodeIndex != NODE_UNUSED) {
-        allocator->m_nodes[topNodeIndex].binListPrev = nodeIndex;
+        allocator->m_binLinks[topNodeIndex].binListPrev = nodeIndex;
     }
     allocator->m_binIndices[binIndex] = nodeIndex;
+    allocator->m_binCounts[binIndex]++;
 
     allocator->m_freeStorage += size;
 #ifdef DEBUG_VERBOSE
-    printf("Free storage: %u (+%u) (insertNodeIntoBin)\n",
-           allocator->m_freeStorage, size);
+    printf("Free storage: %llu (+%llu) (linkNodeIntoBin)\n",
+           (uint64)allocator->m_freeStorage, (uint64)size);
 #endif
+}
 
+// The freelist is a stack of m_freeOffset + 1 nodes. Recycled nodes are
+// stored in m_freeNodes at their stack position. Below them the never used
+// nodes [m_freeHighWater, m_maxAllocs) are implicit, lowest index on top,
+// so a reset doesn't need to write out the whole stack.
+static inline uint32 popFreeNode(Allocator* allocator) {
+    uint32 nodeIndex;
+    uint32 neverUsed = allocator->m_maxAllocs - allocator->m_freeHighWater;
+    if (allocator->m_freeOffset < neverUsed) {
+        nodeIndex = allocator->m_freeHighWater++;
+#ifdef USE_GENERATIONAL_HANDLES
+        // First use since init: start its generation
+        if (nodeIndex == allocator->m_generationsUsed) {
+            allocator->m_generations[nodeIndex] = 0;
+            allocator->m_generationsUsed++;
+        }
+#endif
+    } else {
+        nodeIndex = allocator->m_freeNodes[allocator->m_freeOffset];
+    }
+    allocator->m_freeOffset--;
     return nodeIndex;
 }
 
-static void removeNodeFromBin(Allocator* allocator, const uint32 nodeIndex) {
+static uint32 insertNodeIntoBin(Allocator* allocator,
+                                const OffsetType size,
+                                const OffsetType dataOffset) {
+    // Take a freelist node and insert on top of the bin linked list
+    uint32 nodeIndex = popFreeNode(allocator);
+    INSTRUMENT(recordNodeUsage(allocator));
+#ifdef DEBUG_VERBOSE
+    printf("Getting node %u from freelist[%u]\n", nodeIndex,
+           allocator->m_freeOffset + 1);
+#endif
+    allocator->m_nodes[nodeIndex].dataOffset = dataOffset;
+    allocator->m_nodes[nodeIndex].dataSize = size;
+    allocator->m_nodes[nodeIndex].neighborPrev = NODE_UNUSED;
+    allocator->m_nodes[nodeIndex].neighborNext = NODE_UNUSED;
+    linkNodeIntoBin(allocator, nodeIndex);
+
+    return nodeIndex;
+}
+
+// Unlinks a free node from its bin linked list. The node is not recycled.
+static void unlinkNodeFromBin(Allocator* allocator, const uint32 nodeIndex) {
     Node node = &(allocator->m_nodes[nodeIndex]);
+    BinLinks links = &(allocator->m_binLinks[nodeIndex]);
+    OffsetType size = nodeSize(node);
 
-    if (node->binListPrev != NODE_UNUSED) {
+    // Round down to bin index to ensure that bin >= alloc
+    uint32 binIndex = uintToFloatRoundDown(size);
+    allocator->m_binCounts[binIndex]--;
+
+    if (links->binListPrev != NODE_UNUSED) {
         // Easy case: We have previous node. Just remove this node from the
         // middle of the list.
-        allocator->m_nodes[node->binListPrev].binListNext = node->binListNext;
-        if (node->binListNext != NODE_UNUSED) {
-            allocator->m_nodes[node->binListNext].binListPrev =
-                node->binListPrev;
+        allocator->m_binLinks[links->binListPrev].binListNext =
+            links->binListNext;
+        if (links->binListNext != NODE_UNUSED) {
+            allocator->m_binLinks[links->binListNext].binListPrev =
+                links->binListPrev;
         }
     } else {
-        // Hard case: We are the first node in a bin. Find the bin.
-
-        // Round down to bin index to ensure that bin >= alloc
-        uint32 binIndex = uintToFloatRoundDown(node->dataSize);
-
+        // Hard case: We are the first node in a bin
         uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
         uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
 
-        allocator->m_binIndices[binIndex] = node->binListNext;
-        if (node->binListNext != NODE_UNUSED) {
-            allocator->m_nodes[node->binListNext].binListPrev = NODE_UNUSED;
+        allocator->m_binIndices[binIndex] = links->binListNext;
+        if (links->binListNext != NODE_UNUSED) {
+            allocator->m_binLinks[links->binListNext].binListPrev = NODE_UNUSED;
         }
 
         // Bin empty?
         if (allocator->m_binIndices[binIndex] == NODE_UNUSED) {
             // Remove a leaf bin mask bit
-            allocator->m_usedBins[topBinIndex] &= ~(1 << leafBinIndex);
+            allocator->m_usedBins[topBinIndex] &=
+            ~((LeafBinsMask)1 << leafBinIndex);
 
             // All leaf bins empty?
             if (allocator->m_usedBins[topBinIndex] == 0) {
                 // Remove a top bin mask bit
-                allocator->m_usedBinsTop &= ~(1 << topBinIndex);
+                allocator->m_usedBinsTop &= ~((TopBinsMask)1 << topBinIndex);
             }
         }
     }
 
+    allocator->m_freeStorage -= size;
+#ifdef DEBUG_VERBOSE
+    printf("Free storage: %llu (-%llu) (unlinkNodeFromBin)\n",
+           (uint64)allocator->m_freeStorage, (uint64)size);
+#endif
+}
+
+static void removeNodeFromBin(Allocator* allocator, const uint32 nodeIndex) {
+    unlinkNodeFromBin(allocator, nodeIndex);
+    if (allocator->m_defragNode == nodeIndex)
+        allocator->m_defragNode = NODE_UNUSED;  // Merged away: rescan
+
     // Insert the node to freelist
 #ifdef DEBUG_VERBOSE
     printf("Putting node %u into freelist[%u] (removeNodeFromBin)\n", nodeIndex,
            allocator->m_freeOffset + 1);
 #endif
     allocator->m_freeNodes[++allocator->m_freeOffset] = nodeIndex;
-
-    allocator->m_freeStorage -= node->dataSize;
-#ifdef DEBUG_VERBOSE
-    printf("Free storage: %u (-%u) (removeNodeFromBin)\n",
-           allocator->m_freeStorage, node->dataSize);
-#endif
 }
 
-static uint32 allocationSize(const Allocator* allocator,
-                             const Allocation allocation) {
-    if (allocation.metadata == NO_SPACE)
+OffsetType allocationSize(const Allocator* allocator,
+                          const Allocation allocation) {
+    if (allocation.metadata == NODE_UNUSED)
         return 0;
     if (!allocator->m_nodes)
         return 0;
+#ifdef USE_GENERATIONAL_HANDLES
+    if (!allocationValid(allocator, allocation))
+        return 0;
+#endif
 
-    return allocator->m_nodes[allocation.metadata].dataSize;
+    return nodeSize(&allocator->m_nodes[allocation.metadata]);
 }
 
 StorageReport storageReport(const Allocator* allocator) {
-    uint32 largestFreeRegion = 0;
-    uint32 freeStorage = 0;
+    OffsetType largestFreeRegion = 0;
+    OffsetType freeStorage = 0;
 
     // Out of allocations? -> Zero free space
     if (allocator->m_freeOffset > 0) {
         freeStorage = allocator->m_freeStorage;
         if (allocator->m_usedBinsTop) {
-            uint32 topBinIndex = 31 - lzcnt_nonzero(allocator->m_usedBinsTop);
+            uint32 topBinIndex = highestTopBin(allocator->m_usedBinsTop);
             uint32 leafBinIndex =
-                31 - lzcnt_nonzero(allocator->m_usedBins[topBinIndex]);
+                highestLeafBin(allocator->m_usedBins[topBinIndex]);
             largestFreeRegion = floatToUint(
                 (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex);
             ASSERT(freeStorage >= largestFreeRegion);
@@ -494,14 +1640,455 @@ StorageReport storageReport(const Allocator* allocator) {
 StorageReportFull storageReportFull(const Allocator* allocator) {
     StorageReportFull report;
     for (uint32 i = 0; i < NUM_LEAF_BINS; i++) {
-        uint32 count = 0;
-        uint32 nodeIndex = allocator->m_binIndices[i];
-        while (nodeIndex != NODE_UNUSED) {
-            nodeIndex = allocator->m_nodes[nodeIndex].binListNext;
-            count++;
-        }
         report.freeRegions[i].size = floatToUint(i);
-        report.freeRegions[i].count = count;
+        report.freeRegions[i].count = allocator->m_binCounts[i];
     }
     return report;
 }
+
+void initRangeIterator(AllocatorRangeIterator* iterator,
+                       const Allocator* allocator) {
+    iterator->m_node = allocator->m_nodes ? allocator->m_headNode : NODE_UNUSED;
+}
+
+void initRangeIteratorAt(AllocatorRangeIterator* iterator,
+                         const Allocator* allocator,
+                         const Allocation allocation) {
+    iterator->m_node = allocationValid(allocator, allocation)
+                           ? allocation.metadata
+                           : NODE_UNUSED;
+}
+
+bool nextRange(AllocatorRangeIterator* iterator,
+               const Allocator* allocator,
+               AllocatorRange* range) {
+    if (iterator->m_node == NODE_UNUSED)
+        return false;
+
+    const struct _Node* node = &allocator->m_nodes[iterator->m_node];
+    range->offset = node->dataOffset;
+    range->size = nodeSize(node);
+    range->used = nodeUsed(node);
+    range->metadata = iterator->m_node;
+    iterator->m_node = node->neighborNext;
+    return true;
+}
+
+OffsetType freeSpaceInRange(const Allocator* allocator,
+                            const Allocation allocation,
+                            const OffsetType end) {
+    AllocatorRangeIterator iterator;
+    initRangeIteratorAt(&iterator, allocator, allocation);
+
+    OffsetType freeSpace = 0;
+    AllocatorRange range;
+    while (nextRange(&iterator, allocator, &range) && range.offset < end) {
+        if (range.used)
+            continue;
+        OffsetType rangeEnd = range.offset + range.size;
+        freeSpace += (rangeEnd < end ? rangeEnd : end) - range.offset;
+    }
+    return freeSpace;
+}
+
+float fragmentationScore(const Allocator* allocator) {
+    StorageReport report = storageReport(allocator);
+    if (report.totalFreeSpace == 0)
+        return 0.0f;
+    return 1.0f -
+           (float)((double)report.largestFreeRegion / report.totalFreeSpace);
+}
+
+// Local invariants of a node in the address order list at expectedOffset
+static AllocatorValidation validateNode(const Allocator* allocator,
+                                        const uint32 nodeIndex,
+                                        const OffsetType expectedOffset) {
+    const uint32 numNodes = allocator->m_freeHighWater;
+    if (nodeIndex >= numNodes)
+        return ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+
+    Node node = &(allocator->m_nodes[nodeIndex]);
+    OffsetType size = nodeSize(node);
+    if (node->dataOffset != expectedOffset ||
+        size > allocator->m_size - node->dataOffset) {
+        return ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+    }
+
+    uint32 prev = node->neighborPrev;
+    if (prev == NODE_UNUSED ? allocator->m_headNode != nodeIndex
+                            : prev >= numNodes ||
+                                  allocator->m_nodes[prev].neighborNext !=
+                                      nodeIndex) {
+        return ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+    }
+
+    uint32 next = node->neighborNext;
+    if (next == NODE_UNUSED) {
+        if (allocator->m_tailNode != nodeIndex ||
+            node->dataOffset + size != allocator->m_size) {
+            return ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+        }
+    } else if (next >= numNodes ||
+               allocator->m_nodes[next].neighborPrev != nodeIndex) {
+        return ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+    }
+
+    if (nodeUsed(node))
+        return ALLOCATOR_VALID;
+
+    // Free: merged with its neighbors (checking the next one is enough)
+    if (next != NODE_UNUSED && !nodeUsed(&allocator->m_nodes[next]))
+        return ALLOCATOR_INVALID_ADJACENT_FREE;
+
+    // ... and linked into the bin of its size
+    uint32 binIndex = uintToFloatRoundDown(size);
+    BinLinks links = &(allocator->m_binLinks[nodeIndex]);
+    uint32 binPrev = links->binListPrev;
+    uint32 binNext = links->binListNext;
+    if (binPrev == NODE_UNUSED ? allocator->m_binIndices[binIndex] != nodeIndex
+                               : binPrev >= numNodes ||
+                                     allocator->m_binLinks[binPrev]
+                                             .binListNext != nodeIndex) {
+        return ALLOCATOR_INVALID_BIN_LINKS;
+    }
+    if (binNext != NODE_UNUSED &&
+        (binNext >= numNodes ||
+         allocator->m_binLinks[binNext].binListPrev != nodeIndex)) {
+        return ALLOCATOR_INVALID_BIN_LINKS;
+    }
+
+    uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
+    uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
+    if (!(allocator->m_usedBins[topBinIndex] &
+          ((LeafBinsMask)1 << leafBinIndex)) ||
+        !(allocator->m_usedBinsTop & ((TopBinsMask)1 << topBinIndex))) {
+        return ALLOCATOR_INVALID_BIN_MASKS;
+    }
+    return ALLOCATOR_VALID;
+}
+
+// Mask bits of a top bin and its leaf bins match the bin lists
+static bool validateTopBinMasks(const Allocator* allocator,
+                                const uint32 topBinIndex) {
+    LeafBinsMask leafBits = 0;
+    for (uint32 i = 0; i < BINS_PER_LEAF; i++) {
+        uint32 binIndex = (topBinIndex << TOP_BINS_INDEX_SHIFT) | i;
+        if (allocator->m_binIndices[binIndex] != NODE_UNUSED)
+            leafBits |= (LeafBinsMask)1 << i;
+    }
+    bool topBit =
+        (allocator->m_usedBinsTop & ((TopBinsMask)1 << topBinIndex)) != 0;
+    return allocator->m_usedBins[topBinIndex] == leafBits &&
+           topBit == (leafBits != 0);
+}
+
+AllocatorValidation validateAllocator(const Allocator* allocator,
+                                      uint32* badNode) {
+    uint32 unused;
+    if (!badNode)
+        badNode = &unused;
+    *badNode = NODE_UNUSED;
+    if (!allocator->m_nodes)
+        return ALLOCATOR_VALID;
+
+    // Address order: every node, bounded against cycles
+    uint32 numListed = 0;
+    uint32 numFree = 0;
+    OffsetType freeStorage = 0;
+    OffsetType offset = 0;
+    for (uint32 nodeIndex = allocator->m_headNode; nodeIndex != NODE_UNUSED;
+         nodeIndex = allocator->m_nodes[nodeIndex].neighborNext) {
+        AllocatorValidation result = validateNode(allocator, nodeIndex, offset);
+        if (result == ALLOCATOR_VALID && ++numListed > allocator->m_maxAllocs)
+            result = ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+        if (result != ALLOCATOR_VALID) {
+            *badNode = nodeIndex;
+            return result;
+        }
+
+        Node node = &(allocator->m_nodes[nodeIndex]);
+        offset += nodeSize(node);
+        if (!nodeUsed(node)) {
+            numFree++;
+            freeStorage += nodeSize(node);
+        }
+    }
+    if (offset != allocator->m_size)
+        return ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+
+    // Bins: only free nodes of the bin's size, as many as counted. With the
+    // per node checks above this also rules out free nodes outside the list.
+    uint32 numBinned = 0;
+    for (uint32 binIndex = 0; binIndex < NUM_LEAF_BINS; binIndex++) {
+        uint32 count = 0;
+        for (uint32 nodeIndex = allocator->m_binIndices[binIndex];
+             nodeIndex != NODE_UNUSED;
+             nodeIndex = allocator->m_binLinks[nodeIndex].binListNext) {
+            if (nodeIndex >= allocator->m_freeHighWater ||
+                nodeUsed(&allocator->m_nodes[nodeIndex]) ||
+                uintToFloatRoundDown(nodeSize(
+                    &allocator->m_nodes[nodeIndex])) != binIndex ||
+                ++count > numFree) {
+                *badNode = nodeIndex < allocator->m_freeHighWater ? nodeIndex
+                                                                  : NODE_UNUSED;
+                return ALLOCATOR_INVALID_BIN_LINKS;
+            }
+        }
+        if (count != allocator->m_binCounts[binIndex])
+            return ALLOCATOR_INVALID_FREE_STORAGE;
+        numBinned += count;
+    }
+    if (numBinned != numFree)
+        return ALLOCATOR_INVALID_BIN_LINKS;
+
+    for (uint32 i = 0; i < NUM_TOP_BINS; i++) {
+        if (!validateTopBinMasks(allocator, i))
+            return ALLOCATOR_INVALID_BIN_MASKS;
+    }
+
+    if (freeStorage != allocator->m_freeStorage)
+        return ALLOCATOR_INVALID_FREE_STORAGE;
+
+    // The freelist holds m_freeOffset + 1 nodes (see popFreeNode)
+    if (numListed + allocator->m_freeOffset + 1 != allocator->m_maxAllocs)
+        return ALLOCATOR_INVALID_NODE_COUNT;
+    return ALLOCATOR_VALID;
+}
+
+void initAllocatorValidator(AllocatorValidator* validator) {
+    validator->m_node = NODE_UNUSED;
+    validator->m_offset = 0;
+    validator->m_visited = 0;
+    validator->m_topBin = 0;
+    validator->m_passes = 0;
+}
+
+AllocatorValidation validateAllocatorStep(const Allocator* allocator,
+                                          AllocatorValidator* validator,
+                                          const uint32 maxNodes,
+                                          uint32* badNode) {
+    uint32 unused;
+    if (!badNode)
+        badNode = &unused;
+    *badNode = NODE_UNUSED;
+    if (!allocator->m_nodes)
+        return ALLOCATOR_VALID;
+
+    uint32 topBinIndex = validator->m_topBin;
+    validator->m_topBin = (topBinIndex + 1) % NUM_TOP_BINS;
+    if (!validateTopBinMasks(allocator, topBinIndex))
+        return ALLOCATOR_INVALID_BIN_MASKS;
+
+    // Resuming: the cursor node must still be at its offset and linked from
+    // its previous neighbor, otherwise it changed since the last step
+    uint32 nodeIndex = validator->m_node;
+    if (nodeIndex != NODE_UNUSED) {
+        Node node = &(allocator->m_nodes[nodeIndex]);
+        uint32 prev = node->neighborPrev;
+        if (nodeIndex >= allocator->m_freeHighWater ||
+            node->dataOffset != validator->m_offset ||
+            (prev == NODE_UNUSED
+                 ? allocator->m_headNode != nodeIndex
+                 : prev >= allocator->m_freeHighWater ||
+                       allocator->m_nodes[prev].neighborNext != nodeIndex)) {
+            nodeIndex = NODE_UNUSED;
+        }
+    }
+    if (nodeIndex == NODE_UNUSED) {
+        nodeIndex = allocator->m_headNode;
+        validator->m_offset = 0;
+        validator->m_visited = 0;
+    }
+
+    for (uint32 i = 0; i < maxNodes; i++) {
+        AllocatorValidation result =
+            validateNode(allocator, nodeIndex, validator->m_offset);
+        if (result == ALLOCATOR_VALID &&
+            ++validator->m_visited > allocator->m_maxAllocs) {
+            result = ALLOCATOR_INVALID_NEIGHBOR_LINKS;
+        }
+        if (result != ALLOCATOR_VALID) {
+            *badNode = nodeIndex;
+            validator->m_node = NODE_UNUSED;
+            return result;
+        }
+
+        Node node = &(allocator->m_nodes[nodeIndex]);
+        validator->m_offset += nodeSize(node);
+        nodeIndex = node->neighborNext;
+        if (nodeIndex == NODE_UNUSED) {
+            validator->m_passes++;
+            break;
+        }
+    }
+    validator->m_node = nodeIndex;
+    return ALLOCATOR_VALID;
+}
+
+// Snapshots: header | Allocator | nodes | bin links | freelist | generations.
+// Raw struct copies, so loading requires the same build configuration. The
+// header catches mismatches (sizes, compile options) instead of misreading.
+static const uint32 SNAPSHOT_MAGIC = 0x4e53414f;  // "OASN"
+static const uint32 SNAPSHOT_VERSION = 1;
+
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 config;         // Compile options, see snapshotConfig()
+    uint32 allocatorSize;  // sizeof(Allocator)
+    uint32 nodeSize;       // sizeof(struct _Node)
+    uint32 maxAllocs;
+} SnapshotHeader;
+
+static uint32 snapshotConfig(void) {
+    uint32 config = (uint32)sizeof(OffsetType) |
+                    (uint32)sizeof(NodeIndex) << 4 | MANTISSA_BITS << 8;
+#ifdef USE_PACKED_NODES
+    config |= 1u << 16;
+#endif
+#ifdef USE_GENERATIONAL_HANDLES
+    config |= 1u << 17;
+#endif
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+    config |= 1u << 18;
+#endif
+    return config;
+}
+
+static uint64 snapshotArraysSize(const uint32 maxAllocs) {
+    uint64 perNode = sizeof(struct _Node) + sizeof(struct _BinLinks) +
+                     sizeof(NodeIndex);
+#ifdef USE_GENERATIONAL_HANDLES
+    perNode += sizeof(uint32);
+#endif
+    return perNode * maxAllocs;
+}
+
+uint64 allocatorSnapshotSize(const Allocator* allocator) {
+    return sizeof(SnapshotHeader) + sizeof(Allocator) +
+           snapshotArraysSize(allocator->m_maxAllocs);
+}
+
+// Writes count elements and zero pads up to capacity
+static uint8* copySnapshotArray(uint8* out,
+                                const void* data,
+                                const uint32 count,
+                                const uint32 capacity,
+                                const uint64 elementSize) {
+    memcpy(out, data, count * elementSize);
+    memset(out + count * elementSize, 0, (capacity - count) * elementSize);
+    return out + capacity * elementSize;
+}
+
+uint64 saveAllocatorSnapshot(const Allocator* allocator,
+                             void* buffer,
+                             const uint64 bufferSize) {
+    // Queued remote frees live outside the snapshot: drain them first
+    ASSERT(allocator->m_remoteFrees == 0);
+
+    uint64 size = allocatorSnapshotSize(allocator);
+    if (bufferSize < size)
+        return 0;
+
+    uint32 maxAllocs = allocator->m_maxAllocs;
+    SnapshotHeader header = {.magic = SNAPSHOT_MAGIC,
+                             .version = SNAPSHOT_VERSION,
+                             .config = snapshotConfig(),
+                             .allocatorSize = sizeof(Allocator),
+                             .nodeSize = sizeof(struct _Node),
+                             .maxAllocs = maxAllocs};
+
+    uint8* out = (uint8*)buffer;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    memcpy(out, allocator, sizeof(Allocator));
+    out += sizeof(Allocator);
+    // Unwritten metadata is stored as zeros
+    uint32 highWater = allocator->m_freeHighWater;
+    uint32 recycledFirst = maxAllocs - highWater;
+    uint32 recycledCount = allocator->m_freeOffset + 1 - recycledFirst;
+    out = copySnapshotArray(out, allocator->m_nodes, highWater, maxAllocs,
+                            sizeof(struct _Node));
+    out = copySnapshotArray(out, allocator->m_binLinks, highWater, maxAllocs,
+                            sizeof(struct _BinLinks));
+    memset(out, 0, recycledFirst * sizeof(NodeIndex));
+    out = copySnapshotArray(out + recycledFirst * sizeof(NodeIndex),
+                            &allocator->m_freeNodes[recycledFirst],
+                            recycledCount, maxAllocs - recycledFirst,
+                            sizeof(NodeIndex));
+#ifdef USE_GENERATIONAL_HANDLES
+    copySnapshotArray(out, allocator->m_generations,
+                      allocator->m_generationsUsed, maxAllocs,
+                      sizeof(uint32));
+#endif
+    return size;
+}
+
+bool initAllocatorFromSnapshot(Allocator* allocator,
+                               const void* snapshot,
+                               const uint64 snapshotSize) {
+    SnapshotHeader header;
+    if (snapshotSize < sizeof(header) + sizeof(Allocator))
+        return false;
+    memcpy(&header, snapshot, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.config != snapshotConfig() ||
+        header.allocatorSize != sizeof(Allocator) ||
+        header.nodeSize != sizeof(struct _Node) ||
+        snapshotSize < sizeof(header) + sizeof(Allocator) +
+                           snapshotArraysSize(header.maxAllocs)) {
+        return false;
+    }
+
+    // Checked on a copy: a rejected snapshot leaves the allocator untouched
+    const uint8* in = (const uint8*)snapshot + sizeof(header);
+    Allocator loaded;
+    memcpy(&loaded, in, sizeof(Allocator));
+    in += sizeof(Allocator);
+
+    // The body must agree with the header the arrays were sized from
+    uint32 maxAllocs = header.maxAllocs;
+    if (loaded.m_maxAllocs != maxAllocs || loaded.m_freeOffset >= maxAllocs ||
+        loaded.m_freeHighWater > maxAllocs) {
+        return false;
+    }
+    void* metadata = malloc(requiredMetadataBytes(maxAllocs));
+    if (!metadata)
+        return false;
+
+    *allocator = loaded;
+    carveMetadata(allocator, metadata, maxAllocs);
+    allocator->m_ownsMetadata = true;
+    allocator->m_remoteFrees = 0;
+#ifdef USE_ALLOCATOR_TRACE
+    allocator->m_traceId = 0;  // Not traced until registered again
+#endif
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+    allocator->m_eventCallback = NULL;
+    allocator->m_eventUserData = NULL;
+#endif
+
+    memcpy(allocator->m_nodes, in, maxAllocs * sizeof(struct _Node));
+    in += maxAllocs * sizeof(struct _Node);
+    memcpy(allocator->m_binLinks, in, maxAllocs * sizeof(struct _BinLinks));
+    in += maxAllocs * sizeof(struct _BinLinks);
+    memcpy(allocator->m_freeNodes, in, maxAllocs * sizeof(NodeIndex));
+    in += maxAllocs * sizeof(NodeIndex);
+#ifdef USE_GENERATIONAL_HANDLES
+    memcpy(allocator->m_generations, in, maxAllocs * sizeof(uint32));
+#endif
+    return true;
+}
+
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+const AllocatorStats* allocatorStats(const Allocator* allocator) {
+    return &allocator->m_stats;
+}
+
+void setAllocatorEventCallback(Allocator* allocator,
+                               AllocatorEventCallback callback,
+                               void* userData) {
+    allocator->m_eventCallback = callback;
+    allocator->m_eventUserData = userData;
+}
+#endif
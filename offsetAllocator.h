@@ -2,13 +2,41 @@
 // (C) Sebastian Aaltonen 2023
 // MIT License (see file: LICENSE)
 
-// #define USE_16_BIT_OFFSETS
+#include <stdbool.h>
+
+// #define USE_16_BIT_NODE_INDICES
 
 typedef unsigned char uint8;
 typedef unsigned short uint16;
 typedef unsigned int uint32;
+typedef unsigned long long uint64;
+
+// 64 bit offsets mode manages ranges larger than 4 GiB (sparse virtual address
+// ranges, large GPU heaps). Offsets and sizes become 64 bit and the float bin
+// distribution is extended up to bin 495 with a 64 bit top level bitfield.
+// #define USE_64_BIT_OFFSETS
+
+// Packed nodes fold the used flag into the top bit of the node size. This
+// shrinks the hot node data from 20 to 16 bytes (16 to 12 bytes with 16 bit
+// node indices), but limits the allocator size to 2^31 elements.
+// #define USE_PACKED_NODES
+
+// Instrumentation collects counters (allocations, failures per bin, merges,
+// splits, high-water marks) and calls an optional event callback on every
+// allocate, free and failure. Compiled out entirely when not defined.
+// #define USE_ALLOCATOR_INSTRUMENTATION
+
+// Generational handles tag every Allocation with the generation of its node.
+// Frees and queries of stale handles (freed, double freed, from before a
+// reset) are detected in O(1) and ignored, also in release builds. Costs 4
+// bytes per node and per Allocation.
+// #define USE_GENERATIONAL_HANDLES
+
+// Allocation trace hooks (see allocatorTrace.h). Compiled out entirely when
+// not defined.
+// #define USE_ALLOCATOR_TRACE
 
-// 16 bit offsets mode will halve the metadata storage cost
+// 16 bit node indices mode will halve the node link storage cost
 // But it only supports up to 65536 maximum allocation count
 #ifdef USE_16_BIT_NODE_INDICES
 typedef uint16 NodeIndex;
@@ -17,57 +45,450 @@ typedef uint32 NodeIndex;
 #endif
 
 typedef struct _Node* Node;
+typedef struct _BinLinks* BinLinks;
+
+// Bin resolution: 2^MANTISSA_BITS bins per power of two. The worst case
+// overhead of a rounded up allocation is 1 / 2^MANTISSA_BITS: 2 = 25%,
+// 3 = 12.5% (default), 4 = 6.25%, 5 = 3.1%, 6 = 1.6%. More bits means more
+// bins (larger Allocator struct) and a wider leaf bitfield.
+#ifndef MANTISSA_BITS
+#define MANTISSA_BITS 3
+#endif
+
+#if MANTISSA_BITS < 2 || MANTISSA_BITS > 6
+#error "MANTISSA_BITS must be in [2, 6]"
+#elif MANTISSA_BITS <= 3
+typedef uint8 LeafBinsMask;
+#elif MANTISSA_BITS == 4
+typedef uint16 LeafBinsMask;
+#elif MANTISSA_BITS == 5
+typedef uint32 LeafBinsMask;
+#else
+typedef uint64 LeafBinsMask;
+#endif
 
+#ifdef USE_64_BIT_OFFSETS
+typedef uint64 OffsetType;
+typedef uint64 TopBinsMask;
+#define NUM_TOP_BINS 64
+#else
+typedef uint32 OffsetType;
+typedef uint32 TopBinsMask;
 #define NUM_TOP_BINS 32
-#define BINS_PER_LEAF 8
-#define TOP_BINS_INDEX_SHIFT 3
-#define LEAF_BINS_INDEX_MASK 0x7
+#endif
+
+// One top bin per power of two, one leaf bin per mantissa value
+#define BINS_PER_LEAF (1 << MANTISSA_BITS)
+#define TOP_BINS_INDEX_SHIFT MANTISSA_BITS
+#define LEAF_BINS_INDEX_MASK (BINS_PER_LEAF - 1)
 #define NUM_LEAF_BINS (NUM_TOP_BINS * BINS_PER_LEAF)
 
-extern const uint32 NO_SPACE;  // Declaración, sin definir aquí
+extern const OffsetType NO_SPACE;  // Declaración, sin definir aquí
+extern const NodeIndex NODE_UNUSED;  // All bits set, in NodeIndex width
 
 #define EmptyAllocation \
-    { .offset = NO_SPACE, .metadata = NO_SPACE }
+    { .offset = NO_SPACE, .metadata = NODE_UNUSED }
 
 typedef struct {
-    uint32 offset;
+    OffsetType offset;
     NodeIndex metadata;  // internal: node index
+#ifdef USE_GENERATIONAL_HANDLES
+    uint32 generation;  // internal: node generation at allocation time
+#endif
 } Allocation;
 
+typedef enum {
+    REALLOCATE_FAILED,    // Out of space, allocation is unchanged
+    REALLOCATE_IN_PLACE,  // Offset is unchanged
+    REALLOCATE_MOVED,     // New offset, copy the contents from the old one
+} ReallocateResult;
+
 typedef struct {
-    uint32 totalFreeSpace;
-    uint32 largestFreeRegion;
+    NodeIndex metadata;  // Allocation.metadata of the moved allocation
+    OffsetType oldOffset;
+    OffsetType newOffset;
+    OffsetType size;
+} DefragMove;
+
+typedef struct {
+    OffsetType totalFreeSpace;
+    OffsetType largestFreeRegion;
 } StorageReport;
 
 typedef struct {
     struct {
-        uint32 size;
+        OffsetType size;
         uint32 count;
     } freeRegions[NUM_LEAF_BINS];
 } StorageReportFull;
 
+// One node in address order
+typedef struct {
+    OffsetType offset;
+    OffsetType size;
+    bool used;
+    NodeIndex metadata;  // Allocation.metadata of a used range
+} AllocatorRange;
+
+typedef struct {
+    uint32 m_node;  // Next node to report
+} AllocatorRangeIterator;
+
+typedef enum {
+    ALLOCATOR_VALID,
+    // Asymmetric or cyclic neighbor links, or a gap/overlap between ranges
+    ALLOCATOR_INVALID_NEIGHBOR_LINKS,
+    ALLOCATOR_INVALID_ADJACENT_FREE,  // Two free neighbors: a missed merge
+    // Free node not linked into the bin list of its size (or a bin list
+    // holding a used node)
+    ALLOCATOR_INVALID_BIN_LINKS,
+    ALLOCATOR_INVALID_BIN_MASKS,  // Mask bit set for an empty bin or not set
+    // m_freeStorage or the bin counts don't match the free nodes
+    ALLOCATOR_INVALID_FREE_STORAGE,
+    // Nodes in address order + freelist != max allocs: lost or duplicated
+    ALLOCATOR_INVALID_NODE_COUNT,
+} AllocatorValidation;
+
+// Incremental validation cursor (validateAllocatorStep)
+typedef struct {
+    uint32 m_node;       // Next node to check, NODE_UNUSED = start a pass
+    OffsetType m_offset; // Expected offset of m_node
+    uint32 m_visited;    // Nodes checked in this pass (cycle detection)
+    uint32 m_topBin;     // Next top bin for the mask check
+    uint64 m_passes;     // Completed passes over all nodes
+} AllocatorValidator;
+
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+typedef enum {
+    ALLOCATOR_EVENT_ALLOCATE,
+    ALLOCATOR_EVENT_FREE,
+    ALLOCATOR_EVENT_FAILURE,  // offset = NO_SPACE
+} AllocatorEventType;
+
+// binIndex = uintToFloatRoundUp(size), the size class of the request
+typedef void (*AllocatorEventCallback)(void* userData,
+                                       AllocatorEventType type,
+                                       OffsetType offset,
+                                       OffsetType size,
+                                       uint32 binIndex);
+
 typedef struct {
-    uint32 m_size;
+    uint64 allocations;
+    uint64 frees;
+    uint64 failures;
+    uint64 merges;  // Free neighbors absorbed when freeing
+    uint64 splits;  // Reminder and padding nodes split off
+    uint32 failuresByBin[NUM_LEAF_BINS];
+    OffsetType maxUsedStorage;  // High-water mark of m_size - m_freeStorage
+    uint32 maxUsedNodes;        // High-water mark of nodes taken from freelist
+    uint64 rejectedFrees;       // USE_GENERATIONAL_HANDLES: stale handles
+} AllocatorStats;
+#endif
+
+typedef enum {
+    // Pops the first node of the lowest bin that is guaranteed to fit
+    ALLOCATOR_POLICY_FIRST_FIT,
+    // First probes the round down bin of the size for a node that fits
+    // (up to BEST_FIT_PROBE_COUNT nodes). A few ns slower, denser heap.
+    ALLOCATOR_POLICY_BEST_FIT,
+} AllocatorPolicy;
+
+#define BEST_FIT_PROBE_COUNT 8
+
+// Lifetime hint for allocateWithHint(). Long lived ranges are carved from
+// the start of a free node and transient ones from its end, so that freed
+// transients leave holes next to free space instead of between long lived
+// ranges.
+typedef enum {
+    ALLOCATION_LIFETIME_LONG,       // Same as allocate()
+    ALLOCATION_LIFETIME_TRANSIENT,
+} AllocationLifetime;
+
+// Deferred frees are grouped per fence value in a small ring
+#define DEFERRED_FREE_GROUPS 16
+
+typedef struct {
+    uint64 fence;
+    NodeIndex head;  // Chain of deferred nodes, NODE_UNUSED = empty
+} DeferredFreeGroup;
+
+typedef struct {
+    OffsetType m_size;
     uint32 m_maxAllocs;
-    uint32 m_freeStorage;
+    OffsetType m_freeStorage;
+    AllocatorPolicy m_policy;
 
-    uint32 m_usedBinsTop;
-    uint8 m_usedBins[NUM_TOP_BINS];
+    TopBinsMask m_usedBinsTop;
+    LeafBinsMask m_usedBins[NUM_TOP_BINS];
     NodeIndex m_binIndices[NUM_LEAF_BINS];
+    uint32 m_binCounts[NUM_LEAF_BINS];  // Free nodes per bin
 
     Node m_nodes;
-    NodeIndex* m_freeNodes;
+    BinLinks m_binLinks;
+    NodeIndex* m_freeNodes;  // Recycled nodes, see popFreeNode
     uint32 m_freeOffset;
+    uint32 m_freeHighWater;  // Nodes from here on unused since reset
+#ifdef USE_GENERATIONAL_HANDLES
+    uint32* m_generations;     // Per node, bumped on every free
+    uint32 m_generationsUsed;  // Nodes ever handed out (initialized entries)
+#endif
+    void* m_metadata;     // Single block holding all the node arrays
+    bool m_ownsMetadata;  // False: caller provided (initAllocatorWithStorage)
+
+    NodeIndex m_headNode;  // First node in address order
+    NodeIndex m_tailNode;  // Last node in address order
+    NodeIndex m_defragNode;  // Free node defragmentStep bubbles up, all nodes
+                             // before it are used. NODE_UNUSED = rescan.
+
+    // Lock-free stack of frees pushed by other threads (node index + 1,
+    // 0 = empty). Linked through the bin list links of the used nodes.
+    volatile long m_remoteFrees;
+
+    DeferredFreeGroup m_deferredGroups[DEFERRED_FREE_GROUPS];
+    uint32 m_deferredFirst;  // Oldest group in the ring
+    uint32 m_deferredCount;
+
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+    AllocatorStats m_stats;
+    AllocatorEventCallback m_eventCallback;
+    void* m_eventUserData;
+#endif
+#ifdef USE_ALLOCATOR_TRACE
+    uint32 m_traceId;  // 0 = not traced, see traceAllocator()
+#endif
 } Allocator;
 
 void initAllocator(Allocator* allocator,
-                   const uint32 size,
+                   const OffsetType size,
                    const uint32 max_allocs);
 
+// Bytes of node metadata for max_allocs nodes (initAllocatorWithStorage)
+uint64 requiredMetadataBytes(const uint32 max_allocs);
+
+// Compile time upper bound of requiredMetadataBytes(), for static or inline
+// storage. Exact on ABIs that align OffsetType to its size.
+#ifdef USE_PACKED_NODES
+#define ALLOCATOR_NODE_FIELD_BYTES                                            \
+    (2 * sizeof(OffsetType) + 2 * sizeof(NodeIndex))
+#else
+#define ALLOCATOR_NODE_FIELD_BYTES                                            \
+    (2 * sizeof(OffsetType) + 2 * sizeof(NodeIndex) + sizeof(bool))
+#endif
+#define ALLOCATOR_NODE_BYTES                                                  \
+    ((ALLOCATOR_NODE_FIELD_BYTES + sizeof(OffsetType) - 1) /                  \
+     sizeof(OffsetType) * sizeof(OffsetType))
+#define ALLOCATOR_METADATA_ALIGN(bytes) (((bytes) + 7) & ~(uint64)7)
+#ifdef USE_GENERATIONAL_HANDLES
+#define ALLOCATOR_GENERATION_BYTES(max_allocs)                                \
+    ALLOCATOR_METADATA_ALIGN((uint64)(max_allocs) * sizeof(uint32))
+#else
+#define ALLOCATOR_GENERATION_BYTES(max_allocs) 0
+#endif
+#define ALLOCATOR_METADATA_BYTES(max_allocs)                                  \
+    (ALLOCATOR_METADATA_ALIGN((uint64)(max_allocs) * ALLOCATOR_NODE_BYTES) +  \
+     ALLOCATOR_METADATA_ALIGN((uint64)(max_allocs) * 2 * sizeof(NodeIndex)) + \
+     ALLOCATOR_METADATA_ALIGN((uint64)(max_allocs) * sizeof(NodeIndex)) +     \
+     ALLOCATOR_GENERATION_BYTES(max_allocs))
+
+// Like initAllocator, but places the node metadata in caller memory (8 byte
+// aligned, at least requiredMetadataBytes(max_allocs)). The allocator never
+// frees it, and growAllocator can't add nodes.
+void initAllocatorWithStorage(Allocator* allocator,
+                              const OffsetType size,
+                              const uint32 max_allocs,
+                              void* storage,
+                              const uint64 storageBytes);
+
+// Frees everything. Reuses the node metadata, nothing is reallocated.
+// Queued remote frees are discarded: stop remote producers first.
 void resetAllocator(Allocator* allocator);
 
+// Selects the allocate() search policy. Default: ALLOCATOR_POLICY_FIRST_FIT.
+// Call after initAllocator(), the policy survives resetAllocator().
+void setAllocatorPolicy(Allocator* allocator, const AllocatorPolicy policy);
+
 void terminateAllocator(Allocator* allocator);
 
-Allocation allocate(Allocator* allocator, const uint32 size);
+// Grows the managed range to [0, newSize) and the node pool to newMaxAllocs
+// without a reset. Existing allocations are untouched, the new space merges
+// with the last free node. Returns false if out of memory (or out of nodes
+// to describe the new space, or the node metadata is caller provided).
+// Remote producers must be stopped and their frees drained first.
+bool growAllocator(Allocator* allocator,
+                   const OffsetType newSize,
+                   const uint32 newMaxAllocs);
+
+Allocation allocate(Allocator* allocator, const OffsetType size);
+
+// Allocates a range whose offset is a multiple of alignment (power of two).
+// The leading padding is returned to the bins as a free node.
+Allocation allocateAligned(Allocator* allocator,
+                           const OffsetType size,
+                           const OffsetType alignment);
+
+// allocate() with a lifetime hint (same bin search and policy)
+Allocation allocateWithHint(Allocator* allocator,
+                            const OffsetType size,
+                            const AllocationLifetime lifetime);
 
 void freeAllocation(Allocator* allocator, Allocation allocation);
+
+// True if the allocation is live. With USE_GENERATIONAL_HANDLES this also
+// rejects stale handles whose node was freed and reused since.
+bool allocationValid(const Allocator* allocator, const Allocation allocation);
+
+// Frees an allocation from any thread without locking the allocator. The
+// range is returned to the bins when the owning thread drains the queue,
+// either explicitly or at its next allocate(). All other calls stay owner
+// thread only. growAllocator and resetAllocator additionally require every
+// remote producer to be stopped: a push writes into the node arrays that
+// grow reallocates, and a push racing a reset would queue a stale node.
+// Drain before growing (reset discards the queue).
+void freeAllocationRemote(Allocator* allocator, Allocation allocation);
+
+// Owner thread: merges all queued remote frees. Returns the number drained.
+uint32 drainRemoteFrees(Allocator* allocator);
+
+// Frees an allocation once the caller's fence (e.g. GPU frame index) has
+// completed. Fences must be non-decreasing. The range stays used until
+// retireUpTo() is called with completedFence >= fence. When more than
+// DEFERRED_FREE_GROUPS fences are in flight, the newest group takes the new
+// fence (its frees are retired later, never earlier).
+void freeAllocationDeferred(Allocator* allocator,
+                            Allocation allocation,
+                            const uint64 fence);
+
+// Frees all deferred allocations with fence <= completedFence, merging them
+// in one batch. Returns the number of allocations freed.
+uint32 retireUpTo(Allocator* allocator, const uint64 completedFence);
+
+// Resizes an allocation. Shrinks in place, grows in place when the next
+// neighbor is free and large enough, otherwise moves. On REALLOCATE_MOVED the
+// old range is already freed but its contents are untouched until the next
+// allocation, so copy from the old offset before allocating again.
+ReallocateResult reallocate(Allocator* allocator,
+                            Allocation* allocation,
+                            const OffsetType newSize);
+
+// Allocates count ranges in one go. Failed entries are set to
+// EmptyAllocation. Returns the number of successful allocations.
+uint32 allocateBatch(Allocator* allocator,
+                     const OffsetType* sizes,
+                     const uint32 count,
+                     Allocation* allocations);
+
+// Frees count allocations, merging contiguous runs once at the end
+void freeBatch(Allocator* allocator,
+               const Allocation* allocations,
+               const uint32 count);
+
+// Compacts the allocations towards offset 0, at most maxMoves per call.
+// Each move is already committed: copy size elements from oldOffset to
+// newOffset and update the allocation's offset before the next allocation
+// (the free space now overlaps the old range). Moves always go down and
+// overlap when size > oldOffset - newOffset: copy front to back, in chunks
+// of at most oldOffset - newOffset elements if the copy engine requires
+// disjoint ranges. Apply the moves in order. Returns the number of moves,
+// 0 when fully compacted. A call costs O(maxMoves): it continues from the
+// free node of the previous call rather than rescanning the compacted
+// prefix.
+uint32 defragmentStep(Allocator* allocator,
+                      DefragMove* moves,
+                      const uint32 maxMoves);
+
+OffsetType allocationSize(const Allocator* allocator,
+                          const Allocation allocation);
+
+StorageReport storageReport(const Allocator* allocator);
+
+// O(bins): reads the per bin free node counts, doesn't walk the bin lists
+StorageReportFull storageReportFull(const Allocator* allocator);
+
+// Address order walk of all free and used ranges, no allocations. Ranges
+// queued as remote or deferred frees are still reported as used. The
+// allocator must not change during the walk.
+void initRangeIterator(AllocatorRangeIterator* iterator,
+                       const Allocator* allocator);
+
+// Starts the walk at the range of a live allocation (empty if invalid)
+void initRangeIteratorAt(AllocatorRangeIterator* iterator,
+                         const Allocator* allocator,
+                         const Allocation allocation);
+
+// Returns false when past the last range
+bool nextRange(AllocatorRangeIterator* iterator,
+               const Allocator* allocator,
+               AllocatorRange* range);
+
+// Free elements in [allocation.offset, end), walking forward from the
+// allocation's range. O(ranges covered).
+OffsetType freeSpaceInRange(const Allocator* allocator,
+                            const Allocation allocation,
+                            const OffsetType end);
+
+// O(1) fragmentation estimate: 1 - largestFreeRegion / totalFreeSpace.
+// 0 = all free space is one region, close to 1 = badly fragmented.
+float fragmentationScore(const Allocator* allocator);
+
+// Checks every invariant of the node list, the bins and the accounting.
+// O(nodes + bins). badNode (optional) receives the offending node, or
+// NODE_UNUSED when a counter is off. The allocator must not change during
+// the call.
+AllocatorValidation validateAllocator(const Allocator* allocator,
+                                      uint32* badNode);
+
+void initAllocatorValidator(AllocatorValidator* validator);
+
+// Bounded cost validation for production builds: checks the local
+// invariants (links, contiguity, merges, bins and masks) of at most maxNodes
+// nodes in address order from where the previous step stopped, plus the
+// masks of one top bin. The allocator may change between steps: if the
+// cursor node was freed or moved, the pass restarts. The global counters
+// are only checked by validateAllocator().
+AllocatorValidation validateAllocatorStep(const Allocator* allocator,
+                                          AllocatorValidator* validator,
+                                          const uint32 maxNodes,
+                                          uint32* badNode);
+
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+// Counters since init/reset
+const AllocatorStats* allocatorStats(const Allocator* allocator);
+
+// Called synchronously from the allocating/freeing thread. NULL disables.
+void setAllocatorEventCallback(Allocator* allocator,
+                               AllocatorEventCallback callback,
+                               void* userData);
+#endif
+
+// Binary snapshot of the whole allocator state (bins, nodes, freelist).
+// Restoring it is a handful of memcpys instead of replaying the allocations;
+// the buffer can be a memory mapped file. Snapshots are only portable between
+// builds with the same compile options and endianness. Drain remote frees
+// before saving.
+uint64 allocatorSnapshotSize(const Allocator* allocator);
+
+// Returns the number of bytes written, 0 if the buffer is too small
+uint64 saveAllocatorSnapshot(const Allocator* allocator,
+                             void* buffer,
+                             const uint64 bufferSize);
+
+// Initializes the allocator from a snapshot (copies it, the buffer can be
+// released afterwards). Returns false, leaving the allocator untouched, if
+// the snapshot is truncated, inconsistent or from an incompatible build, or
+// if out of memory. Allocations made before the save stay valid.
+bool initAllocatorFromSnapshot(Allocator* allocator,
+                               const void* snapshot,
+                               const uint64 snapshotSize);
+
+// Bin index <-> size conversions (see README bin size table)
+uint32 uintToFloatRoundUp(const OffsetType size);
+
+// uintToFloatRoundUp of count sizes. Uses AVX2 or NEON when the target has
+// it (32 bit offsets only), scalar otherwise.
+void uintToFloatRoundUpBatch(const OffsetType* sizes,
+                             uint32* binIndices,
+                             const uint32 count);
+
+uint32 uintToFloatRoundDown(const OffsetType size);
+
+OffsetType floatToUint(const uint32 floatValue);
@@ -0,0 +1,211 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+// Header-only C++ wrapper of the offset allocator (C++17). Link with
+// offsetAllocator.c built with the same configuration macros.
+//
+// Allocation is a move-only handle that frees its range when destroyed or
+// reset, so ranges can't be freed twice or leaked. The allocator must
+// outlive its handles.
+//
+// The template parameters spell out the configuration a type is written
+// for. Index width and mantissa bits are fixed when offsetAllocator.c is
+// compiled, so they are checked against the build (static_assert) rather
+// than selected per type. MaxAllocs > 0 places the node metadata inside the
+// allocator object: no heap allocation at all. The size can still grow, the
+// node capacity can't.
+//
+// All members are inline and noexcept. Hot paths are a single call into
+// the C library.
+//
+// The C types (::Allocator, ::Allocation) stay in the global namespace:
+// spell out OffsetAllocator::Allocator instead of a using directive.
+
+extern "C" {
+#include "offsetAllocator.h"
+}
+
+namespace OffsetAllocator {
+
+using Offset = OffsetType;
+using Lifetime = AllocationLifetime;
+using Policy = AllocatorPolicy;
+
+// Configuration of the library build
+struct BuildConfig {
+    static constexpr uint32 indexBits = sizeof(NodeIndex) * 8;
+    static constexpr uint32 offsetBits = sizeof(OffsetType) * 8;
+    static constexpr uint32 mantissaBits = MANTISSA_BITS;
+#ifdef USE_GENERATIONAL_HANDLES
+    static constexpr bool generationalHandles = true;
+#else
+    static constexpr bool generationalHandles = false;
+#endif
+};
+
+template <uint32 MaxAllocs = 0,
+          uint32 IndexBits = BuildConfig::indexBits,
+          uint32 MantissaBits = BuildConfig::mantissaBits>
+class BasicAllocator;
+
+class Allocation {
+public:
+    Allocation() noexcept : m_allocator(nullptr), m_allocation(empty()) {}
+    ~Allocation() { reset(); }
+
+    Allocation(const Allocation&) = delete;
+    Allocation& operator=(const Allocation&) = delete;
+
+    Allocation(Allocation&& other) noexcept
+        : m_allocator(other.m_allocator), m_allocation(other.release()) {}
+
+    Allocation& operator=(Allocation&& other) noexcept {
+        if (this != &other) {
+            reset();
+            m_allocator = other.m_allocator;
+            m_allocation = other.release();
+        }
+        return *this;
+    }
+
+    bool valid() const noexcept { return m_allocation.offset != NO_SPACE; }
+    explicit operator bool() const noexcept { return valid(); }
+
+    // NO_SPACE if empty
+    Offset offset() const noexcept { return m_allocation.offset; }
+
+    // Allocated size (the requested size, not the bin size)
+    Offset size() const noexcept {
+        return valid() ? allocationSize(m_allocator, m_allocation) : 0;
+    }
+
+    // Frees the range now
+    void reset() noexcept {
+        if (valid())
+            freeAllocation(m_allocator, m_allocation);
+        m_allocator = nullptr;
+        m_allocation = empty();
+    }
+
+    // Gives up ownership: free the returned handle with the C API
+    ::Allocation release() noexcept {
+        ::Allocation allocation = m_allocation;
+        m_allocator = nullptr;
+        m_allocation = empty();
+        return allocation;
+    }
+
+    const ::Allocation& native() const noexcept { return m_allocation; }
+
+private:
+    template <uint32, uint32, uint32>
+    friend class BasicAllocator;
+
+    Allocation(::Allocator* allocator, const ::Allocation allocation) noexcept
+        : m_allocator(allocation.offset != NO_SPACE ? allocator : nullptr),
+          m_allocation(allocation) {}
+
+    static ::Allocation empty() noexcept {
+        ::Allocation allocation = {};
+        allocation.offset = NO_SPACE;
+        allocation.metadata = NODE_UNUSED;
+        return allocation;
+    }
+
+    ::Allocator* m_allocator;
+    ::Allocation m_allocation;
+};
+
+template <uint32 MaxAllocs, uint32 IndexBits, uint32 MantissaBits>
+class BasicAllocator {
+    static_assert(IndexBits == BuildConfig::indexBits,
+                  "IndexBits doesn't match the library build "
+                  "(USE_16_BIT_NODE_INDICES)");
+    static_assert(MantissaBits == BuildConfig::mantissaBits,
+                  "MantissaBits doesn't match the library build "
+                  "(MANTISSA_BITS)");
+    static_assert(IndexBits == 32 || MaxAllocs <= 65536,
+                  "16 bit node indices address at most 65536 nodes");
+
+public:
+    static constexpr uint32 fixedMaxAllocs = MaxAllocs;
+    // 16 bit node indices address at most 65536 nodes
+    static constexpr uint32 defaultMaxAllocs =
+        MaxAllocs ? MaxAllocs : IndexBits == 16 ? 65536 : 128 * 1024;
+
+    // Inline storage (MaxAllocs > 0): maxAllocs must be <= MaxAllocs
+    explicit BasicAllocator(
+        const Offset size,
+        const uint32 maxAllocs = defaultMaxAllocs) noexcept {
+        if constexpr (MaxAllocs > 0) {
+            initAllocatorWithStorage(&m_allocator, size, maxAllocs, m_storage,
+                                     sizeof(m_storage));
+        } else {
+            initAllocator(&m_allocator, size, maxAllocs);
+        }
+    }
+
+    ~BasicAllocator() { terminateAllocator(&m_allocator); }
+
+    // Handles (and the inline storage) point into the object: not movable
+    BasicAllocator(const BasicAllocator&) = delete;
+    BasicAllocator& operator=(const BasicAllocator&) = delete;
+
+    Allocation allocate(const Offset size) noexcept {
+        return Allocation(&m_allocator, ::allocate(&m_allocator, size));
+    }
+
+    Allocation allocateAligned(const Offset size,
+                               const Offset alignment) noexcept {
+        return Allocation(&m_allocator,
+                          ::allocateAligned(&m_allocator, size, alignment));
+    }
+
+    Allocation allocate(const Offset size, const Lifetime lifetime) noexcept {
+        return Allocation(&m_allocator,
+                          allocateWithHint(&m_allocator, size, lifetime));
+    }
+
+    // Same as allocation.reset()
+    void free(Allocation& allocation) noexcept { allocation.reset(); }
+
+    void setPolicy(const Policy policy) noexcept {
+        setAllocatorPolicy(&m_allocator, policy);
+    }
+
+    // Inline storage: false if newMaxAllocs exceeds the current capacity,
+    // growing the size alone works
+    bool grow(const Offset newSize, const uint32 newMaxAllocs) noexcept {
+        return growAllocator(&m_allocator, newSize, newMaxAllocs);
+    }
+
+    StorageReport storageReport() const noexcept {
+        return ::storageReport(&m_allocator);
+    }
+
+    float fragmentation() const noexcept {
+        return fragmentationScore(&m_allocator);
+    }
+
+    AllocatorValidation validate(uint32* badNode = nullptr) const noexcept {
+        return validateAllocator(&m_allocator, badNode);
+    }
+
+    // For the rest of the C API. Don't free handles owned by an Allocation.
+    ::Allocator* native() noexcept { return &m_allocator; }
+    const ::Allocator* native() const noexcept { return &m_allocator; }
+
+private:
+    ::Allocator m_allocator;
+    alignas(8) uint8 m_storage[MaxAllocs ? ALLOCATOR_METADATA_BYTES(MaxAllocs)
+                                         : 1];
+};
+
+// Heap allocated node metadata, growable
+using Allocator = BasicAllocator<>;
+
+// Node metadata inside the object
+template <uint32 MaxAllocs>
+using FixedAllocator = BasicAllocator<MaxAllocs>;
+
+}  // namespace OffsetAllocator
@@ -0,0 +1,129 @@
+// MIT License (see file: LICENSE)
+
+#include "shardedAllocator.h"
+#include <stdlib.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+static const uint32 NODE_INDEX_BITS = sizeof(NodeIndex) * 8;
+
+void initShardedAllocator(ShardedAllocator* sharded,
+                          const OffsetType size,
+                          const uint32 max_allocs,
+                          const uint32 num_shards) {
+    ASSERT(num_shards > 0);
+
+    // Reserve enough high metadata bits to address every shard. At least one
+    // bit is always reserved to keep the shift below the NodeIndex width.
+    uint32 shardBits = 1;
+    while ((1u << shardBits) < num_shards)
+        shardBits++;
+
+    sharded->m_numShards = num_shards;
+    sharded->m_shardShift = NODE_INDEX_BITS - shardBits;
+    sharded->m_shards =
+        (AllocatorShard*)calloc(num_shards, sizeof(AllocatorShard));
+
+    OffsetType shardSize = size / num_shards;
+    uint32 shardMaxAllocs = max_allocs / num_shards;
+
+    // Node indices must stay clear of the shard bits (and of NODE_UNUSED)
+    ASSERT(shardMaxAllocs < (1u << sharded->m_shardShift));
+
+    for (uint32 i = 0; i < num_shards; i++) {
+        AllocatorShard* shard = &sharded->m_shards[i];
+        initSpinLock(&shard->m_lock);
+        shard->m_baseOffset = i * shardSize;
+
+        // Last shard takes the rounding remainder
+        OffsetType thisSize =
+            (i == num_shards - 1) ? size - shard->m_baseOffset : shardSize;
+        initAllocator(&shard->m_allocator, thisSize, shardMaxAllocs);
+    }
+}
+
+void resetShardedAllocator(ShardedAllocator* sharded) {
+    for (uint32 i = 0; i < sharded->m_numShards; i++) {
+        AllocatorShard* shard = &sharded->m_shards[i];
+        lockSpinLock(&shard->m_lock);
+        resetAllocator(&shard->m_allocator);
+        unlockSpinLock(&shard->m_lock);
+    }
+}
+
+void terminateShardedAllocator(ShardedAllocator* sharded) {
+    for (uint32 i = 0; i < sharded->m_numShards; i++) {
+        terminateAllocator(&sharded->m_shards[i].m_allocator);
+    }
+    free(sharded->m_shards);
+    sharded->m_shards = NULL;
+    sharded->m_numShards = 0;
+}
+
+Allocation shardedAllocate(ShardedAllocator* sharded,
+                           const OffsetType size,
+                           const uint32 shardHint) {
+    Allocation res = EmptyAllocation;
+
+    // Start from the caller's shard, then walk the neighbors
+    uint32 shardIndex = shardHint % sharded->m_numShards;
+    for (uint32 i = 0; i < sharded->m_numShards; i++) {
+        AllocatorShard* shard = &sharded->m_shards[shardIndex];
+
+        lockSpinLock(&shard->m_lock);
+        Allocation local = allocate(&shard->m_allocator, size);
+        unlockSpinLock(&shard->m_lock);
+
+        if (local.offset != NO_SPACE) {
+            res = local;  // Keeps the handle generation, if any
+            res.offset = shard->m_baseOffset + local.offset;
+            res.metadata = (NodeIndex)((shardIndex << sharded->m_shardShift) |
+                                       local.metadata);
+            return res;
+        }
+
+        if (++shardIndex == sharded->m_numShards)
+            shardIndex = 0;
+    }
+
+    return res;
+}
+
+void shardedFreeAllocation(ShardedAllocator* sharded, Allocation allocation) {
+    ASSERT(allocation.offset != NO_SPACE);
+
+    uint32 shardIndex = (uint32)allocation.metadata >> sharded->m_shardShift;
+    ASSERT(shardIndex < sharded->m_numShards);
+    AllocatorShard* shard = &sharded->m_shards[shardIndex];
+
+    Allocation local = allocation;
+    local.offset = allocation.offset - shard->m_baseOffset;
+    local.metadata = (NodeIndex)(allocation.metadata &
+                                 ((1u << sharded->m_shardShift) - 1));
+
+    lockSpinLock(&shard->m_lock);
+    freeAllocation(&shard->m_allocator, local);
+    unlockSpinLock(&shard->m_lock);
+}
+
+StorageReport shardedStorageReport(ShardedAllocator* sharded) {
+    StorageReport report = {.totalFreeSpace = 0, .largestFreeRegion = 0};
+
+    for (uint32 i = 0; i < sharded->m_numShards; i++) {
+        AllocatorShard* shard = &sharded->m_shards[i];
+
+        lockSpinLock(&shard->m_lock);
+        StorageReport shardReport = storageReport(&shard->m_allocator);
+        unlockSpinLock(&shard->m_lock);
+
+        report.totalFreeSpace += shardReport.totalFreeSpace;
+        if (shardReport.largestFreeRegion > report.largestFreeRegion)
+            report.largestFreeRegion = shardReport.largestFreeRegion;
+    }
+    return report;
+}
@@ -0,0 +1,43 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocator.h"
+#include "spinLock.h"
+
+// Thread-safe front-end that splits [0, size) into N independent Allocator
+// shards, each guarded by its own lock. Threads allocate from their own shard
+// (shardHint, e.g. the worker index) and fall over to the neighboring shards
+// when it is full. The owning shard id is stored in the high bits of
+// Allocation.metadata, so frees are routed back without any lookup.
+//
+// NOTE: A single allocation can't span shards, so the largest allocation is
+// bounded by size / num_shards.
+
+typedef struct {
+    SpinLock m_lock;
+    OffsetType m_baseOffset;
+    Allocator m_allocator;
+} AllocatorShard;
+
+typedef struct {
+    uint32 m_numShards;
+    uint32 m_shardShift;
+    AllocatorShard* m_shards;
+} ShardedAllocator;
+
+void initShardedAllocator(ShardedAllocator* sharded,
+                          const OffsetType size,
+                          const uint32 max_allocs,
+                          const uint32 num_shards);
+
+void resetShardedAllocator(ShardedAllocator* sharded);
+
+void terminateShardedAllocator(ShardedAllocator* sharded);
+
+Allocation shardedAllocate(ShardedAllocator* sharded,
+                           const OffsetType size,
+                           const uint32 shardHint);
+
+void shardedFreeAllocation(ShardedAllocator* sharded, Allocation allocation);
+
+StorageReport shardedStorageReport(ShardedAllocator* sharded);
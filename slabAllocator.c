@@ -0,0 +1,210 @@
+// MIT License (see file: LICENSE)
+
+#include "slabAllocator.h"
+#include <stdlib.h>
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define SLAB_MIN_SLOT_SHIFT 4  // log2(SLAB_MIN_SLOT_SIZE)
+
+static inline uint32 lzcnt_nonzero(uint32 v) {
+#ifdef _MSC_VER
+    unsigned long retVal;
+    _BitScanReverse(&retVal, v);
+    return 31 - retVal;
+#else
+    return __builtin_clz(v);
+#endif
+}
+
+static inline uint32 tzcnt_nonzero(uint32 v) {
+#ifdef _MSC_VER
+    unsigned long retVal;
+    _BitScanForward(&retVal, v);
+    return retVal;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+static inline uint32 slabClassIndex(const OffsetType size) {
+    if (size <= SLAB_MIN_SLOT_SIZE)
+        return 0;
+    // Round up to a power of two
+    uint32 shift = 32 - lzcnt_nonzero((uint32)size - 1);
+    return shift - SLAB_MIN_SLOT_SHIFT;
+}
+
+static void linkPartialChunk(SlabAllocator* slab, const uint32 chunkIndex) {
+    SlabChunk* chunk = &slab->m_chunks[chunkIndex];
+    uint32 head = slab->m_partialChunks[chunk->m_classIndex];
+    chunk->m_prevPartial = SLAB_NONE;
+    chunk->m_nextPartial = head;
+    if (head != SLAB_NONE)
+        slab->m_chunks[head].m_prevPartial = chunkIndex;
+    slab->m_partialChunks[chunk->m_classIndex] = chunkIndex;
+}
+
+static void unlinkPartialChunk(SlabAllocator* slab, const uint32 chunkIndex) {
+    SlabChunk* chunk = &slab->m_chunks[chunkIndex];
+    if (chunk->m_prevPartial != SLAB_NONE) {
+        slab->m_chunks[chunk->m_prevPartial].m_nextPartial =
+            chunk->m_nextPartial;
+    } else {
+        slab->m_partialChunks[chunk->m_classIndex] = chunk->m_nextPartial;
+    }
+    if (chunk->m_nextPartial != SLAB_NONE) {
+        slab->m_chunks[chunk->m_nextPartial].m_prevPartial =
+            chunk->m_prevPartial;
+    }
+}
+
+// Carves a new chunk of the class from the parent. Returns SLAB_NONE if out
+// of chunks or parent space.
+static uint32 addChunk(SlabAllocator* slab, const uint32 classIndex) {
+    if (slab->m_freeChunkCount == 0)
+        return SLAB_NONE;
+
+    OffsetType slotSize = (OffsetType)SLAB_MIN_SLOT_SIZE << classIndex;
+    Allocation block =
+        allocate(slab->m_allocator, slotSize * SLAB_SLOTS_PER_CHUNK);
+    if (block.offset == NO_SPACE)
+        return SLAB_NONE;
+
+    uint32 chunkIndex = slab->m_freeChunks[--slab->m_freeChunkCount];
+    SlabChunk* chunk = &slab->m_chunks[chunkIndex];
+    chunk->m_block = block;
+    chunk->m_classIndex = classIndex;
+    chunk->m_freeSlots = SLAB_SLOTS_PER_CHUNK;
+    chunk->m_summary = (uint32)((1ull << SLAB_BITMAP_WORDS) - 1);
+    for (uint32 i = 0; i < SLAB_BITMAP_WORDS; i++) {
+        chunk->m_freeBits[i] = 0xffffffff;
+    }
+    linkPartialChunk(slab, chunkIndex);
+    return chunkIndex;
+}
+
+static void removeChunk(SlabAllocator* slab, const uint32 chunkIndex) {
+    SlabChunk* chunk = &slab->m_chunks[chunkIndex];
+    unlinkPartialChunk(slab, chunkIndex);
+    freeAllocation(slab->m_allocator, chunk->m_block);
+    slab->m_freeChunks[slab->m_freeChunkCount++] = chunkIndex;
+}
+
+void initSlabAllocator(SlabAllocator* slab,
+                       Allocator* allocator,
+                       const uint32 max_chunks) {
+    slab->m_allocator = allocator;
+    slab->m_maxChunks = max_chunks;
+    slab->m_chunks = (SlabChunk*)malloc(max_chunks * sizeof(SlabChunk));
+    slab->m_freeChunks = (uint32*)malloc(max_chunks * sizeof(uint32));
+
+    // Stack in inverse order so that chunk [0] pops first
+    slab->m_freeChunkCount = max_chunks;
+    for (uint32 i = 0; i < max_chunks; i++) {
+        slab->m_freeChunks[i] = max_chunks - i - 1;
+    }
+    for (uint32 i = 0; i < SLAB_NUM_CLASSES; i++) {
+        slab->m_partialChunks[i] = SLAB_NONE;
+        slab->m_emptyChunks[i] = SLAB_NONE;
+    }
+}
+
+void terminateSlabAllocator(SlabAllocator* slab) {
+    // Chunks in use are either partial or full: free every carved block
+    bool* unused = (bool*)calloc(slab->m_maxChunks, sizeof(bool));
+    for (uint32 i = 0; i < slab->m_freeChunkCount; i++) {
+        unused[slab->m_freeChunks[i]] = true;
+    }
+    for (uint32 i = 0; i < slab->m_maxChunks; i++) {
+        if (!unused[i])
+            freeAllocation(slab->m_allocator, slab->m_chunks[i].m_block);
+    }
+    free(unused);
+
+    free(slab->m_chunks);
+    free(slab->m_freeChunks);
+    slab->m_chunks = NULL;
+    slab->m_freeChunks = NULL;
+}
+
+OffsetType slabSlotSize(const OffsetType size) {
+    if (size > SLAB_MAX_SLOT_SIZE)
+        return 0;
+    return (OffsetType)SLAB_MIN_SLOT_SIZE << slabClassIndex(size);
+}
+
+SlabAllocation slabAllocate(SlabAllocator* slab, const OffsetType size) {
+    SlabAllocation res = EmptySlabAllocation;
+    if (size == 0 || size > SLAB_MAX_SLOT_SIZE)
+        return res;
+
+    uint32 classIndex = slabClassIndex(size);
+    uint32 chunkIndex = slab->m_partialChunks[classIndex];
+    if (chunkIndex == SLAB_NONE) {
+        chunkIndex = addChunk(slab, classIndex);
+        if (chunkIndex == SLAB_NONE)
+            return res;
+    }
+
+    // Partial chunks always have a free slot: first set summary bit, then
+    // first set slot bit in that word
+    SlabChunk* chunk = &slab->m_chunks[chunkIndex];
+    ASSERT(chunk->m_summary != 0);
+    if (slab->m_emptyChunks[classIndex] == chunkIndex)
+        slab->m_emptyChunks[classIndex] = SLAB_NONE;
+    uint32 wordIndex = tzcnt_nonzero(chunk->m_summary);
+    uint32 bitIndex = tzcnt_nonzero(chunk->m_freeBits[wordIndex]);
+    chunk->m_freeBits[wordIndex] &= ~(1u << bitIndex);
+    if (chunk->m_freeBits[wordIndex] == 0)
+        chunk->m_summary &= ~(1u << wordIndex);
+
+    // Full? No longer a candidate
+    if (--chunk->m_freeSlots == 0)
+        unlinkPartialChunk(slab, chunkIndex);
+
+    uint32 slotIndex = (wordIndex << 5) | bitIndex;
+    res.offset = chunk->m_block.offset +
+                 ((OffsetType)slotIndex
+                  << (classIndex + SLAB_MIN_SLOT_SHIFT));
+    res.metadata = chunkIndex;
+    return res;
+}
+
+void slabFree(SlabAllocator* slab, SlabAllocation allocation) {
+    ASSERT(allocation.metadata < slab->m_maxChunks);
+    uint32 chunkIndex = allocation.metadata;
+    SlabChunk* chunk = &slab->m_chunks[chunkIndex];
+
+    uint32 slotIndex =
+        (uint32)((allocation.offset - chunk->m_block.offset) >>
+                 (chunk->m_classIndex + SLAB_MIN_SLOT_SHIFT));
+    uint32 wordIndex = slotIndex >> 5;
+    uint32 bitIndex = slotIndex & 31;
+    ASSERT((chunk->m_freeBits[wordIndex] & (1u << bitIndex)) == 0);
+    chunk->m_freeBits[wordIndex] |= 1u << bitIndex;
+    chunk->m_summary |= 1u << wordIndex;
+
+    // Was full? A candidate again
+    if (chunk->m_freeSlots++ == 0)
+        linkPartialChunk(slab, chunkIndex);
+
+    // Empty? Keep one per class (it stays a partial chunk), the rest go back
+    // to the parent
+    if (chunk->m_freeSlots == SLAB_SLOTS_PER_CHUNK) {
+        uint32* emptyChunk = &slab->m_emptyChunks[chunk->m_classIndex];
+        if (*emptyChunk == SLAB_NONE)
+            *emptyChunk = chunkIndex;
+        else
+            removeChunk(slab, chunkIndex);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocator.h"
+
+// Slab front-end for tiny uniform allocations.
+//
+// Sizes up to SLAB_MAX_SLOT_SIZE are rounded up to a power of two slot size
+// class. Each class grabs chunks of SLAB_SLOTS_PER_CHUNK slots from the
+// parent with a single allocate() and serves slots from a two-level free
+// bitmap: a summary word with one bit per bitmap word, then one bit per
+// slot. Allocate and free are a couple of tzcnt and bit flips, no splits or
+// merges, and a slot costs one bit of metadata instead of a parent node.
+// One empty chunk per class is kept, so that allocating and freeing a single
+// object doesn't hit the parent every time. Further empty chunks go back to
+// the parent as soon as their last slot is freed.
+//
+// Larger sizes are not served (offset == NO_SPACE); use the parent.
+// Not thread safe.
+
+#define SLAB_MIN_SLOT_SIZE 16
+#define SLAB_MAX_SLOT_SIZE 256
+#define SLAB_NUM_CLASSES 5  // 16, 32, 64, 128, 256
+#define SLAB_SLOTS_PER_CHUNK 1024
+#define SLAB_BITMAP_WORDS (SLAB_SLOTS_PER_CHUNK / 32)
+
+#define SLAB_NONE 0xffffffff
+
+typedef struct {
+    OffsetType offset;
+    uint32 metadata;  // internal: chunk index
+} SlabAllocation;
+
+#define EmptySlabAllocation \
+    { .offset = NO_SPACE, .metadata = SLAB_NONE }
+
+typedef struct {
+    Allocation m_block;
+    uint32 m_classIndex;
+    uint32 m_freeSlots;
+    uint32 m_prevPartial;  // Chunks of the class with free slots
+    uint32 m_nextPartial;
+    uint32 m_summary;  // Bit per bitmap word: word has a free slot
+    uint32 m_freeBits[SLAB_BITMAP_WORDS];  // Bit per slot: slot is free
+} SlabChunk;
+
+typedef struct {
+    Allocator* m_allocator;
+    uint32 m_maxChunks;
+    SlabChunk* m_chunks;
+    uint32* m_freeChunks;  // Stack of unused chunk indices
+    uint32 m_freeChunkCount;
+    uint32 m_partialChunks[SLAB_NUM_CLASSES];  // List heads, SLAB_NONE = empty
+    uint32 m_emptyChunks[SLAB_NUM_CLASSES];    // Kept empty chunk or SLAB_NONE
+} SlabAllocator;
+
+void initSlabAllocator(SlabAllocator* slab,
+                       Allocator* allocator,
+                       const uint32 max_chunks);
+
+// Returns all chunks to the parent
+void terminateSlabAllocator(SlabAllocator* slab);
+
+// Slot size serving a request, 0 if too large for the slabs
+OffsetType slabSlotSize(const OffsetType size);
+
+SlabAllocation slabAllocate(SlabAllocator* slab, const OffsetType size);
+
+void slabFree(SlabAllocator* slab, SlabAllocation allocation);
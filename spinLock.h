@@ -0,0 +1,43 @@
+#pragma once
+// MIT License (see file: LICENSE)
+
+// Minimal test-and-test-and-set spin lock for the thread-safe front-ends.
+// Critical sections around allocate()/freeAllocation() are a few dozen
+// instructions, so spinning is cheaper than parking the thread in the OS.
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef struct {
+    volatile long m_locked;
+} SpinLock;
+
+static inline void initSpinLock(SpinLock* lock) {
+    lock->m_locked = 0;
+}
+
+static inline void lockSpinLock(SpinLock* lock) {
+    for (;;) {
+#ifdef _MSC_VER
+        if (_InterlockedExchange(&lock->m_locked, 1) == 0)
+            return;
+        while (lock->m_locked)
+            _mm_pause();
+#else
+        if (__atomic_exchange_n(&lock->m_locked, 1, __ATOMIC_ACQUIRE) == 0)
+            return;
+        // Spin on a plain load so that waiters don't bounce the cache line
+        while (__atomic_load_n(&lock->m_locked, __ATOMIC_RELAXED)) {
+        }
+#endif
+    }
+}
+
+static inline void unlockSpinLock(SpinLock* lock) {
+#ifdef _MSC_VER
+    _InterlockedExchange(&lock->m_locked, 0);
+#else
+    __atomic_store_n(&lock->m_locked, 0, __ATOMIC_RELEASE);
+#endif
+}
@@ -0,0 +1,124 @@
+#include "../offsetAllocator.hpp"
+#include "munit.h"
+#include <utility>
+
+// The library is C: build it as C, the wrapper tests as C++, e.g.:
+//   cc -std=c11 -c *.c test/munit.c
+//   c++ -std=c++17 -o tests_hpp test/offsetAllocatorHppTests.cpp *.o
+// with the same configuration macros on both lines.
+
+static_assert(OffsetAllocator::BuildConfig::indexBits ==
+                  sizeof(NodeIndex) * 8,
+              "index width of the build");
+static_assert(sizeof(OffsetAllocator::FixedAllocator<64>) >=
+                  sizeof(Allocator) + ALLOCATOR_METADATA_BYTES(64),
+              "inline node metadata");
+
+static MunitResult testHandles(const MunitParameter params[], void* data) {
+    (void)params;
+    (void)data;
+
+    OffsetAllocator::Allocator allocator(12345);
+    const OffsetAllocator::Offset total =
+        allocator.storageReport().totalFreeSpace;
+    {
+        OffsetAllocator::Allocation a = allocator.allocate(1337);
+        munit_assert_true(a.valid());
+        munit_assert_uint(a.offset(), ==, 0);
+        munit_assert_uint(a.size(), ==, 1337);
+
+        // Moves transfer ownership, the source is empty
+        OffsetAllocator::Allocation b = std::move(a);
+        munit_assert_false(a.valid());
+        munit_assert_uint(a.offset(), ==, NO_SPACE);
+        munit_assert_uint(b.offset(), ==, 0);
+
+        OffsetAllocator::Allocation c = allocator.allocate(123);
+        munit_assert_uint(c.offset(), ==, 1337);
+        c = std::move(b);  // Frees c's old range
+        munit_assert_uint(c.offset(), ==, 0);
+        munit_assert_uint(allocator.storageReport().totalFreeSpace, ==,
+                          total - 1337);
+
+        allocator.free(c);
+        munit_assert_false(c.valid());
+        c.reset();  // Empty: no double free
+        munit_assert_uint(allocator.storageReport().totalFreeSpace, ==, total);
+
+        // Failed allocations are empty handles
+        OffsetAllocator::Allocation failed = allocator.allocate(100000);
+        munit_assert_false(failed);
+        munit_assert_uint(failed.size(), ==, 0);
+
+        OffsetAllocator::Allocation d = allocator.allocate(1000);
+        OffsetAllocator::Allocation e = allocator.allocateAligned(100, 256);
+        munit_assert_uint(e.offset() % 256, ==, 0);
+        OffsetAllocator::Allocation f =
+            allocator.allocate(100, ALLOCATION_LIFETIME_TRANSIENT);
+        munit_assert_uint(f.offset(), ==, 12345 - 100);
+        munit_assert_int(allocator.validate(), ==, ALLOCATOR_VALID);
+    }
+
+    // Scope exit freed everything
+    munit_assert_uint(allocator.storageReport().totalFreeSpace, ==, total);
+    munit_assert_int(allocator.validate(), ==, ALLOCATOR_VALID);
+
+    // release() hands the range to the C API
+    OffsetAllocator::Allocation g = allocator.allocate(10);
+    ::Allocation raw = g.release();
+    munit_assert_false(g.valid());
+    freeAllocation(allocator.native(), raw);
+    munit_assert_uint(allocator.storageReport().totalFreeSpace, ==, total);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testFixedAllocator(const MunitParameter params[],
+                                      void* data) {
+    (void)params;
+    (void)data;
+
+    OffsetAllocator::FixedAllocator<64> allocator(1024 * 1024);
+    const char* begin = reinterpret_cast<const char*>(&allocator);
+    const char* metadata =
+        static_cast<const char*>(allocator.native()->m_metadata);
+    munit_assert_true(metadata >= begin &&
+                      metadata < begin + sizeof(allocator));
+
+    // 62 allocations: one node is reserved, one holds the free remainder
+    OffsetAllocator::Allocation allocations[63];
+    for (uint32 i = 0; i < 62; i++) {
+        allocations[i] = allocator.allocate(1024);
+    }
+    munit_assert_true(allocations[61].valid());
+    allocations[62] = allocator.allocate(1024);
+    munit_assert_false(allocations[62].valid());
+
+    // Inline storage: the size grows, the node capacity doesn't
+    munit_assert_false(allocator.grow(2 * 1024 * 1024, 128));
+    munit_assert_true(allocator.grow(2 * 1024 * 1024, 64));
+    munit_assert_uint(allocator.native()->m_size, ==, 2 * 1024 * 1024);
+
+    // Two merged frees give a node back, the lowest fitting bin is theirs
+    allocations[10].reset();
+    allocations[11].reset();
+    allocations[62] = allocator.allocate(1024);
+    munit_assert_uint(allocations[62].offset(), ==, 10 * 1024);
+    munit_assert_int(allocator.validate(), ==, ALLOCATOR_VALID);
+    return MUNIT_OK;
+}
+
+static MunitTest tests[] = {
+    {(char*)"/testHandles", testHandles, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {(char*)"/testFixedAllocator", testFixedAllocator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite suite = {(char*)"/offset_allocator_hpp_tests", tests,
+                                 NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char* argv[]) {
+    return munit_suite_main(&suite, NULL, argc, argv);
+}
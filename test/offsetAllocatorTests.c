@@ -1,17 +1,39 @@
 #include "../offsetAllocator.h"
+#include "../shardedAllocator.h"
+#include "../allocatorMagazine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../linearAllocator.h"
+#include "../slabAllocator.h"
+#include "../heapManager.h"
+#include "../allocatorTrace.h"
 #include "munit.h"
 
-extern uint32 uintToFloatRoundUp(const uint32 size);
-extern uint32 floatToUint(const uint32 floatValue);
-extern uint32 uintToFloatRoundDown(const uint32 size);
-extern StorageReport storageReport(const Allocator* allocator);
-extern StorageReportFull storageReportFull(const Allocator* allocator);
+// Build and run under every supported node configuration, e.g.:
+//   cc -std=c11 -o tests test/*.c *.c && ./tests
+//   cc -std=c11 -DUSE_16_BIT_NODE_INDICES -o tests test/*.c *.c && ./tests
+//   cc -std=c11 -DUSE_PACKED_NODES -o tests test/*.c *.c && ./tests
+//   cc -std=c11 -DUSE_64_BIT_OFFSETS -o tests test/*.c *.c && ./tests
+//   cc -std=c11 -DUSE_ALLOCATOR_INSTRUMENTATION -o tests test/*.c *.c && ./tests
+//   cc -std=c11 -DMANTISSA_BITS=5 -o tests test/*.c *.c && ./tests
+//   cc -std=c11 -DUSE_GENERATIONAL_HANDLES -o tests test/*.c *.c && ./tests
+//   cc -std=c11 -DUSE_ALLOCATOR_TRACE -o tests test/*.c *.c && ./tests
+
+// Bins whose size fits in OffsetType: 240 (32 bit), 496 (64 bit) at 3 bits
+#define NUM_FLOAT_BINS \
+    ((sizeof(OffsetType) * 8 - MANTISSA_BITS + 1) << MANTISSA_BITS)
+
+// 16 bit node indices only support up to 65536 allocations
+#ifdef USE_16_BIT_NODE_INDICES
+#define MAX_ALLOCS (64 * 1024)
+#else
+#define MAX_ALLOCS (128 * 1024)
+#endif
 
 static MunitResult testUintToFloat() {
     // Denorms, exp=1 and exp=2 + mantissa = 0 are all precise.
-    // NOTE: Assuming 8 value (3 bit) mantissa.
-    // If this test fails, please change this assumption!
-    uint32 preciseNumberCount = 17;
+    // (17 numbers with the default 3 bit mantissa)
+    uint32 preciseNumberCount = (2 << MANTISSA_BITS) + 1;
     for (uint32 i = 0; i < preciseNumberCount; i++) {
         uint32 roundUp = uintToFloatRoundUp(i);
         uint32 roundDown = uintToFloatRoundDown(i);
@@ -19,6 +41,7 @@ static MunitResult testUintToFloat() {
         munit_assert_uint(i, ==, roundDown);
     }
 
+#if MANTISSA_BITS == 3
     // Test some random picked numbers
     typedef struct {
         uint32 number;
@@ -42,14 +65,14 @@ static MunitResult testUintToFloat() {
         munit_assert_uint(roundUp, ==, v.up);
         munit_assert_uint(roundDown, ==, v.down);
     }
+#endif
     return MUNIT_OK;
 }
 
 static MunitResult testFloatToUint() {
     // Denorms, exp=1 and exp=2 + mantissa = 0 are all precise.
-    // NOTE: Assuming 8 value (3 bit) mantissa.
-    // If this test fails, please change this assumption!
-    uint32 preciseNumberCount = 17;
+    // (17 numbers with the default 3 bit mantissa)
+    uint32 preciseNumberCount = (2 << MANTISSA_BITS) + 1;
     for (uint32 i = 0; i < preciseNumberCount; i++) {
         uint32 v = floatToUint(i);
         munit_assert_uint(i, ==, v);
@@ -57,8 +80,9 @@ static MunitResult testFloatToUint() {
 
     // Test that float->uint->float conversion is precise for all numbers
     // NOTE: Test values < 240. 240->4G = overflows 32 bit integer
-    for (uint32 i = 0; i < 240; i++) {
-        uint32 v = floatToUint(i);
+    // (64 bit offsets: 496->16E overflows 64 bit integer)
+    for (uint32 i = 0; i < NUM_FLOAT_BINS; i++) {
+        OffsetType v = floatToUint(i);
         uint32 roundUp = uintToFloatRoundUp(v);
         uint32 roundDown = uintToFloatRoundDown(v);
         munit_assert_uint(i, ==, roundUp);
@@ -72,7 +96,7 @@ static MunitResult testFloatToUint() {
 
 static MunitResult basicOffsetAllocator() {
     Allocator allocator;
-    initAllocator(&allocator, 1024 * 1024 * 256, 128 * 1024);
+    initAllocator(&allocator, 1024 * 1024 * 256, MAX_ALLOCS);
 
     Allocation a = allocate(&allocator, 1337);
     uint32 offset = a.offset;
@@ -85,7 +109,7 @@ static MunitResult basicOffsetAllocator() {
 
 static MunitResult testSimpleAllocateOffsetAllocator() {
     Allocator allocator;
-    initAllocator(&allocator, 1024 * 1024 * 256, 128 * 1024);
+    initAllocator(&allocator, 1024 * 1024 * 256, MAX_ALLOCS);
 
     Allocation a = allocate(&allocator, 0);
     munit_assert_uint(a.offset, ==, 0);
@@ -116,7 +140,7 @@ static MunitResult testSimpleAllocateOffsetAllocator() {
 
 static MunitResult testMergeTrivialOffsetAllocator() {
     Allocator allocator;
-    initAllocator(&allocator, 1024 * 1024 * 256, 128 * 1024);
+    initAllocator(&allocator, 1024 * 1024 * 256, MAX_ALLOCS);
 
     Allocation a = allocate(&allocator, 1337);
     // munit_assert_uint(a.offset, ==, 0);
@@ -139,7 +163,7 @@ static MunitResult testMergeTrivialOffsetAllocator() {
 
 static MunitResult testReuseMergeTrivialOffsetAllocator() {
     Allocator allocator;
-    initAllocator(&allocator, 1024 * 1024 * 256, 128 * 1024);
+    initAllocator(&allocator, 1024 * 1024 * 256, MAX_ALLOCS);
 
     Allocation a = allocate(&allocator, 1024);
     munit_assert_uint(a.offset, ==, 0);
@@ -165,7 +189,7 @@ static MunitResult testReuseMergeTrivialOffsetAllocator() {
 
 static MunitResult testZeroFragmentationOffsetAllocator() {
     Allocator allocator;
-    initAllocator(&allocator, 1024 * 1024 * 256, 128 * 1024);
+    initAllocator(&allocator, 1024 * 1024 * 256, MAX_ALLOCS);
 
     Allocation allocations[256];
 
@@ -222,7 +246,7 @@ static MunitResult testZeroFragmentationOffsetAllocator() {
 
 static MunitResult testOffsetReuseComplexAllocator() {
     Allocator allocator;
-    initAllocator(&allocator, 1024 * 1024 * 256, 128 * 1024);
+    initAllocator(&allocator, 1024 * 1024 * 256, MAX_ALLOCS);
 
     Allocation a = allocate(&allocator, 1024);
     munit_assert_uint(a.offset, ==, 0);
@@ -260,6 +284,1550 @@ static MunitResult testOffsetReuseComplexAllocator() {
     return MUNIT_OK;
 }
 
+static MunitResult testShardedAllocator() {
+    ShardedAllocator sharded;
+    initShardedAllocator(&sharded, 1024 * 4, 1024, 4);
+
+    // Each shard owns a quarter of the range
+    Allocation a = shardedAllocate(&sharded, 512, 0);
+    munit_assert_uint(a.offset, ==, 0);
+    Allocation b = shardedAllocate(&sharded, 512, 2);
+    munit_assert_uint(b.offset, ==, 2048);
+
+    // Shard 0 is full -> falls over to shard 1
+    Allocation c = shardedAllocate(&sharded, 1024, 0);
+    munit_assert_uint(c.offset, ==, 1024);
+
+    // Larger than any shard
+    Allocation d = shardedAllocate(&sharded, 2048, 0);
+    munit_assert_uint(d.offset, ==, NO_SPACE);
+
+    StorageReport report = shardedStorageReport(&sharded);
+    munit_assert_uint(report.totalFreeSpace, ==, 1024 * 4 - 512 - 512 - 1024);
+    munit_assert_uint(report.largestFreeRegion, ==, 1024);
+
+    // Frees must route back to the owning shards
+    shardedFreeAllocation(&sharded, c);
+    shardedFreeAllocation(&sharded, b);
+    shardedFreeAllocation(&sharded, a);
+
+    StorageReport report2 = shardedStorageReport(&sharded);
+    munit_assert_uint(report2.totalFreeSpace, ==, 1024 * 4);
+
+    Allocation e = shardedAllocate(&sharded, 1024, 3);
+    munit_assert_uint(e.offset, ==, 3072);
+    shardedFreeAllocation(&sharded, e);
+
+    terminateShardedAllocator(&sharded);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testAllocatorMagazine() {
+#if MANTISSA_BITS == 3
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, 1024);
+
+    SpinLock lock;
+    initSpinLock(&lock);
+
+    AllocatorMagazine magazine;
+    initAllocatorMagazine(&magazine, &allocator, &lock);
+
+    // 100 -> bin 37 (104): first miss refills a whole batch
+    Allocation a = magazineAllocate(&magazine, 100);
+    munit_assert_uint(a.offset, !=, NO_SPACE);
+    munit_assert_uint(allocationSize(&allocator, a), ==, 104);
+
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==,
+                      1024 * 1024 - 104 * MAGAZINE_BATCH);
+
+    // Freed allocation is cached and handed out again
+    magazineFree(&magazine, a);
+    Allocation b = magazineAllocate(&magazine, 101);
+    munit_assert_uint(b.offset, ==, a.offset);
+    magazineFree(&magazine, b);
+
+    // Uncached size class goes straight through
+    Allocation c = magazineAllocate(&magazine, 100000);
+    munit_assert_uint(allocationSize(&allocator, c), ==, 100000);
+    magazineFree(&magazine, c);
+
+    // Overflowing a bin spills a batch back to the shared allocator
+    Allocation many[MAGAZINE_CAPACITY * 2];
+    for (uint32 i = 0; i < MAGAZINE_CAPACITY * 2; i++) {
+        many[i] = magazineAllocate(&magazine, 64);
+        munit_assert_uint(many[i].offset, !=, NO_SPACE);
+    }
+    for (uint32 i = 0; i < MAGAZINE_CAPACITY * 2; i++) {
+        magazineFree(&magazine, many[i]);
+    }
+
+    // After a flush the shared allocator is whole again
+    flushAllocatorMagazine(&magazine);
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 1024 * 1024);
+    munit_assert_uint(report2.largestFreeRegion, ==, 1024 * 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+#else
+    return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult testBatchAllocateFree() {
+    Allocator single;
+    Allocator batched;
+    initAllocator(&single, 1024 * 1024, 1024);
+    initAllocator(&batched, 1024 * 1024, 1024);
+
+    // Runs of repeating sizes exercise the cached bin search
+    OffsetType sizes[64];
+    for (uint32 i = 0; i < 64; i++) {
+        sizes[i] = (i < 32) ? 100 : 1000 + (i / 8) * 777;
+    }
+
+    // Punch a few holes first so that the batch hits non-trivial bins
+    Allocation holes[8];
+    Allocation holesBatched[8];
+    for (uint32 i = 0; i < 8; i++) {
+        holes[i] = allocate(&single, 300 + i * 100);
+        holesBatched[i] = allocate(&batched, 300 + i * 100);
+        allocate(&single, 16);
+        allocate(&batched, 16);
+    }
+    for (uint32 i = 0; i < 8; i += 2) {
+        freeAllocation(&single, holes[i]);
+        freeAllocation(&batched, holesBatched[i]);
+    }
+
+    // Batch must produce exactly the same layout as sequential allocate()
+    Allocation expected[64];
+    Allocation allocations[64];
+    for (uint32 i = 0; i < 64; i++) {
+        expected[i] = allocate(&single, sizes[i]);
+    }
+    uint32 numAllocated = allocateBatch(&batched, sizes, 64, allocations);
+    munit_assert_uint(numAllocated, ==, 64);
+    for (uint32 i = 0; i < 64; i++) {
+        munit_assert_uint(allocations[i].offset, ==, expected[i].offset);
+    }
+
+    // Too large entries fail individually
+    OffsetType tooLarge[2] = {1024 * 1024, 16};
+    Allocation partial[2];
+    munit_assert_uint(allocateBatch(&batched, tooLarge, 2, partial), ==, 1);
+    munit_assert_uint(partial[0].offset, ==, NO_SPACE);
+    munit_assert_uint(partial[1].offset, !=, NO_SPACE);
+    freeAllocation(&batched, partial[1]);
+
+    StorageReport report = storageReport(&batched);
+
+    // Free in an order that interleaves neighbors
+    Allocation shuffled[64];
+    for (uint32 i = 0; i < 64; i++) {
+        shuffled[i] = allocations[(i * 37) % 64];
+    }
+    freeBatch(&batched, shuffled, 64);
+
+    uint32 totalSize = 0;
+    for (uint32 i = 0; i < 64; i++) {
+        totalSize += sizes[i];
+    }
+    StorageReport report2 = storageReport(&batched);
+    munit_assert_uint(report2.totalFreeSpace, ==,
+                      report.totalFreeSpace + totalSize);
+
+    // Batch allocations were contiguous: must be merged to one region
+    for (uint32 i = 1; i < 8; i += 2) {
+        freeAllocation(&batched, holesBatched[i]);
+    }
+    StorageReportFull full = storageReportFull(&batched);
+    uint32 freeRegions = 0;
+    for (uint32 i = 0; i < NUM_LEAF_BINS; i++) {
+        freeRegions += full.freeRegions[i].count;
+    }
+    // One free region per 16 element separator plus the tail
+    munit_assert_uint(freeRegions, ==, 8 + 1);
+
+    terminateAllocator(&single);
+    terminateAllocator(&batched);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testMaxAllocations() {
+    // 65536 is the full 16 bit node index range
+    const uint32 maxAllocs = 64 * 1024;
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, maxAllocs);
+
+    static Allocation allocations[64 * 1024];
+
+    // One node always holds the free remainder, one stays in reserve
+    uint32 count = 0;
+    for (;;) {
+        Allocation a = allocate(&allocator, 1);
+        if (a.offset == NO_SPACE) {
+            munit_assert_uint(a.metadata, ==, NODE_UNUSED);
+            break;
+        }
+        munit_assert_uint(a.offset, ==, count);
+        munit_assert_uint(a.metadata, !=, NODE_UNUSED);
+        allocations[count++] = a;
+    }
+    munit_assert_uint(count, ==, maxAllocs - 2);
+
+    // Out of nodes -> storage report claims no free space
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 0);
+
+    for (uint32 i = 0; i < count; i++) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 1024 * 1024);
+    munit_assert_uint(report2.largestFreeRegion, ==, 1024 * 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testLargeOffsetAllocator() {
+#ifdef USE_64_BIT_OFFSETS
+    const uint64 GiB = 1024ull * 1024 * 1024;
+
+    Allocator allocator;
+    initAllocator(&allocator, 64 * GiB, MAX_ALLOCS);
+
+    Allocation a = allocate(&allocator, 5 * GiB);
+    munit_assert_uint64(a.offset, ==, 0);
+    Allocation b = allocate(&allocator, 20 * GiB + 1);
+    munit_assert_uint64(b.offset, ==, 5 * GiB);
+    Allocation c = allocate(&allocator, 1337);
+    munit_assert_uint64(c.offset, ==, 25 * GiB + 1);
+    munit_assert_uint64(allocationSize(&allocator, b), ==, 20 * GiB + 1);
+
+    Allocation d = allocate(&allocator, 40 * GiB);
+    munit_assert_uint64(d.offset, ==, NO_SPACE);
+
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint64(report.totalFreeSpace, ==,
+                        64 * GiB - 25 * GiB - 1 - 1337);
+
+    freeAllocation(&allocator, b);
+    freeAllocation(&allocator, a);
+    freeAllocation(&allocator, c);
+
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint64(report2.totalFreeSpace, ==, 64 * GiB);
+    munit_assert_uint64(report2.largestFreeRegion, ==, 64 * GiB);
+
+    Allocation validateAll = allocate(&allocator, 64 * GiB);
+    munit_assert_uint64(validateAll.offset, ==, 0);
+    freeAllocation(&allocator, validateAll);
+
+    terminateAllocator(&allocator);
+    return MUNIT_OK;
+#else
+    return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult testAlignedAllocate() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, MAX_ALLOCS);
+
+    Allocation a = allocate(&allocator, 1);
+    munit_assert_uint(a.offset, ==, 0);
+
+    // Leading padding [1, 256) goes back to the bins
+    Allocation b = allocateAligned(&allocator, 100, 256);
+    munit_assert_uint(b.offset, ==, 256);
+    munit_assert_uint(allocationSize(&allocator, b), ==, 100);
+
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 1024 * 1024 - 1 - 100);
+
+    // ...and can be reused by the next fitting allocation
+    Allocation c = allocate(&allocator, 200);
+    munit_assert_uint(c.offset, ==, 1);
+
+    // Already aligned offset: no padding
+    Allocation d = allocateAligned(&allocator, 4096, 4);
+    munit_assert_uint(d.offset, ==, 356);
+
+    // Large alignment
+    Allocation e = allocateAligned(&allocator, 1000, 64 * 1024);
+    munit_assert_uint(e.offset, ==, 64 * 1024);
+
+    freeAllocation(&allocator, a);
+    freeAllocation(&allocator, b);
+    freeAllocation(&allocator, c);
+    freeAllocation(&allocator, d);
+    freeAllocation(&allocator, e);
+
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 1024 * 1024);
+    munit_assert_uint(report2.largestFreeRegion, ==, 1024 * 1024);
+
+    // Can't fit with alignment
+    Allocation f = allocateAligned(&allocator, 1024 * 1024 - 1, 2);
+    munit_assert_uint(f.offset, ==, 0);
+    Allocation g = allocateAligned(&allocator, 1, 2);
+    munit_assert_uint(g.offset, ==, NO_SPACE);
+    freeAllocation(&allocator, f);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testReallocate() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, MAX_ALLOCS);
+
+    Allocation a = allocate(&allocator, 1000);
+    Allocation b = allocate(&allocator, 1000);
+    munit_assert_uint(b.offset, ==, 1000);
+
+    // Grow into the free tail
+    munit_assert_int(reallocate(&allocator, &b, 5000), ==,
+                     REALLOCATE_IN_PLACE);
+    munit_assert_uint(b.offset, ==, 1000);
+    munit_assert_uint(allocationSize(&allocator, b), ==, 5000);
+
+    // Shrink: tail merges back with the next free node
+    munit_assert_int(reallocate(&allocator, &b, 2000), ==,
+                     REALLOCATE_IN_PLACE);
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 1024 * 1024 - 3000);
+
+    Allocation c = allocate(&allocator, 100);
+    munit_assert_uint(c.offset, ==, 3000);
+
+    // Shrink with a used neighbor: tail becomes its own free node
+    munit_assert_int(reallocate(&allocator, &a, 616), ==,
+                     REALLOCATE_IN_PLACE);
+    Allocation d = allocate(&allocator, 384);
+    munit_assert_uint(d.offset, ==, 616);
+
+    // Grow exactly into a free gap, absorbing the whole node
+    freeAllocation(&allocator, d);
+    munit_assert_int(reallocate(&allocator, &a, 1000), ==,
+                     REALLOCATE_IN_PLACE);
+    munit_assert_uint(a.offset, ==, 0);
+    munit_assert_uint(allocationSize(&allocator, a), ==, 1000);
+
+    // No room next to it: moves
+    munit_assert_int(reallocate(&allocator, &a, 3000), ==, REALLOCATE_MOVED);
+    munit_assert_uint(a.offset, ==, 3100);
+
+    // Too large
+    Allocation before = b;
+    munit_assert_int(reallocate(&allocator, &b, 1024 * 1024), ==,
+                     REALLOCATE_FAILED);
+    munit_assert_uint(b.offset, ==, before.offset);
+
+    freeAllocation(&allocator, a);
+    freeAllocation(&allocator, b);
+    freeAllocation(&allocator, c);
+
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 1024 * 1024);
+    munit_assert_uint(report2.largestFreeRegion, ==, 1024 * 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testGrowAllocator() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024, 8);
+
+    // Out of nodes long before out of space
+    Allocation allocations[16];
+    uint32 count = 0;
+    for (; count < 16; count++) {
+        allocations[count] = allocate(&allocator, 16);
+        if (allocations[count].offset == NO_SPACE)
+            break;
+    }
+    munit_assert_uint(count, ==, 8 - 2);
+
+    // More nodes: continues where it left off
+    munit_assert_true(growAllocator(&allocator, 1024, 32));
+    for (; count < 16; count++) {
+        allocations[count] = allocate(&allocator, 16);
+        munit_assert_uint(allocations[count].offset, ==, count * 16);
+    }
+
+    // Free tail: the new space is merged with it
+    munit_assert_true(growAllocator(&allocator, 16 * 16 + 4096, 32));
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 4096);
+    munit_assert_uint(report.largestFreeRegion, ==, 4096);
+
+    // Used tail: the new space is appended as a new free node after it
+    Allocation rest = allocate(&allocator, 4096);
+    munit_assert_uint(rest.offset, ==, 16 * 16);
+    munit_assert_true(growAllocator(&allocator, 16 * 16 + 8192, 32));
+    Allocation grown = allocate(&allocator, 4096);
+    munit_assert_uint(grown.offset, ==, 16 * 16 + 4096);
+
+    freeAllocation(&allocator, rest);
+    freeAllocation(&allocator, grown);
+    for (uint32 i = 0; i < 16; i++) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 16 * 16 + 8192);
+    munit_assert_uint(report2.largestFreeRegion, ==,
+                      floatToUint(uintToFloatRoundDown(16 * 16 + 8192)));
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testRemoteFree() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024, 16);
+
+    Allocation a = allocate(&allocator, 256);
+    Allocation b = allocate(&allocator, 256);
+    Allocation c = allocate(&allocator, 256);
+
+    // Queued frees don't touch the bins until drained
+    freeAllocationRemote(&allocator, b);
+    freeAllocationRemote(&allocator, a);
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 256);
+
+    // Contiguous queued frees are merged
+    munit_assert_uint(drainRemoteFrees(&allocator), ==, 2);
+    munit_assert_uint(drainRemoteFrees(&allocator), ==, 0);
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 768);
+    munit_assert_uint(report2.largestFreeRegion, ==, 512);
+
+    // allocate() drains the queue first
+    freeAllocationRemote(&allocator, c);
+    Allocation all = allocate(&allocator, 1024);
+    munit_assert_uint(all.offset, ==, 0);
+
+    freeAllocation(&allocator, all);
+    StorageReport report3 = storageReport(&allocator);
+    munit_assert_uint(report3.totalFreeSpace, ==, 1024);
+    munit_assert_uint(report3.largestFreeRegion, ==, 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testDeferredFree() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024, 64);
+
+    Allocation a = allocate(&allocator, 256);
+    Allocation b = allocate(&allocator, 256);
+    Allocation c = allocate(&allocator, 256);
+    Allocation d = allocate(&allocator, 256);
+
+    freeAllocationDeferred(&allocator, a, 1);
+    freeAllocationDeferred(&allocator, b, 2);
+    freeAllocationDeferred(&allocator, c, 2);
+
+    // Nothing is reusable before its fence completes
+    munit_assert_uint(retireUpTo(&allocator, 0), ==, 0);
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 0);
+
+    munit_assert_uint(retireUpTo(&allocator, 1), ==, 1);
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 256);
+
+    // Frames retired together are merged once
+    freeAllocationDeferred(&allocator, d, 3);
+    munit_assert_uint(retireUpTo(&allocator, 3), ==, 3);
+    StorageReport report3 = storageReport(&allocator);
+    munit_assert_uint(report3.totalFreeSpace, ==, 1024);
+    munit_assert_uint(report3.largestFreeRegion, ==, 1024);
+
+    // More fences in flight than groups: the overflow retires with the newest
+    Allocation allocations[DEFERRED_FREE_GROUPS + 4];
+    for (uint32 i = 0; i < DEFERRED_FREE_GROUPS + 4; i++) {
+        allocations[i] = allocate(&allocator, 16);
+        freeAllocationDeferred(&allocator, allocations[i], 10 + i);
+    }
+    munit_assert_uint(retireUpTo(&allocator, 10 + DEFERRED_FREE_GROUPS - 2),
+                      ==, DEFERRED_FREE_GROUPS - 1);
+    munit_assert_uint(retireUpTo(&allocator, 10 + DEFERRED_FREE_GROUPS - 1),
+                      ==, 0);
+    munit_assert_uint(retireUpTo(&allocator, 10 + DEFERRED_FREE_GROUPS + 3),
+                      ==, 5);
+    StorageReport report4 = storageReport(&allocator);
+    munit_assert_uint(report4.totalFreeSpace, ==, 1024);
+    munit_assert_uint(report4.largestFreeRegion, ==, 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testDefragment() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024, 64);
+
+    // Every other allocation freed: plenty of space, all of it fragmented
+    Allocation allocations[16];
+    for (uint32 i = 0; i < 16; i++) {
+        allocations[i] = allocate(&allocator, 64);
+    }
+    for (uint32 i = 0; i < 16; i += 2) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 512);
+    munit_assert_uint(report.largestFreeRegion, ==, 64);
+
+    // Bounded steps until there's nothing left to move
+    DefragMove moves[3];
+    uint32 numMoves = 0;
+    uint32 numSteps = 0;
+    uint32 count;
+    while ((count = defragmentStep(&allocator, moves, 3)) > 0) {
+        munit_assert_uint(count, <=, 3);
+        for (uint32 i = 0; i < count; i++) {
+            munit_assert_uint(moves[i].newOffset, <, moves[i].oldOffset);
+            munit_assert_uint(moves[i].size, ==, 64);
+            for (uint32 j = 1; j < 16; j += 2) {
+                if (allocations[j].metadata == moves[i].metadata) {
+                    munit_assert_uint(allocations[j].offset, ==,
+                                      moves[i].oldOffset);
+                    allocations[j].offset = moves[i].newOffset;
+                }
+            }
+        }
+        numMoves += count;
+        numSteps++;
+    }
+    munit_assert_uint(numMoves, ==, 8);
+    munit_assert_uint(numSteps, ==, 3);
+
+    // Compacted in the original order
+    for (uint32 j = 1; j < 16; j += 2) {
+        munit_assert_uint(allocations[j].offset, ==, (j / 2) * 64);
+    }
+    StorageReport report2 = storageReport(&allocator);
+    munit_assert_uint(report2.totalFreeSpace, ==, 512);
+    munit_assert_uint(report2.largestFreeRegion, ==, 512);
+
+    Allocation big = allocate(&allocator, 512);
+    munit_assert_uint(big.offset, ==, 512);
+    freeAllocation(&allocator, big);
+
+    // A hole below the compacted prefix is found again
+    freeAllocation(&allocator, allocations[1]);
+    numMoves = 0;
+    while ((count = defragmentStep(&allocator, moves, 3)) > 0) {
+        for (uint32 i = 0; i < count; i++) {
+            for (uint32 j = 3; j < 16; j += 2) {
+                if (allocations[j].metadata == moves[i].metadata)
+                    allocations[j].offset = moves[i].newOffset;
+            }
+        }
+        numMoves += count;
+    }
+    munit_assert_uint(numMoves, ==, 7);
+    for (uint32 j = 3; j < 16; j += 2) {
+        munit_assert_uint(allocations[j].offset, ==, (j / 2 - 1) * 64);
+    }
+    munit_assert_int(validateAllocator(&allocator, NULL), ==, ALLOCATOR_VALID);
+
+    for (uint32 j = 3; j < 16; j += 2) {
+        freeAllocation(&allocator, allocations[j]);
+    }
+    StorageReport report3 = storageReport(&allocator);
+    munit_assert_uint(report3.totalFreeSpace, ==, 1024);
+    munit_assert_uint(report3.largestFreeRegion, ==, 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testStorageReportCounts() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, 256);
+    munit_assert_float(fragmentationScore(&allocator), ==, 0.0f);
+
+    // 64 x (64 used + 192 free): 64 free regions of bin 192
+    Allocation allocations[128];
+    for (uint32 i = 0; i < 128; i++) {
+        allocations[i] = allocate(&allocator, i & 1 ? 192 : 64);
+    }
+    for (uint32 i = 1; i < 128; i += 2) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+
+    uint32 bin192 = uintToFloatRoundDown(192);
+    uint32 binTail = uintToFloatRoundDown(1024 * 1024 - 128 * 128);
+    StorageReportFull full = storageReportFull(&allocator);
+    uint32 total = 0;
+    for (uint32 i = 0; i < NUM_LEAF_BINS; i++) {
+        total += full.freeRegions[i].count;
+        if (i != bin192 && i != binTail)
+            munit_assert_uint(full.freeRegions[i].count, ==, 0);
+    }
+    munit_assert_uint(full.freeRegions[bin192].count, ==, 63);
+    munit_assert_uint(full.freeRegions[binTail].count, ==, 1);
+    munit_assert_uint(total, ==, 64);
+    munit_assert_float(fragmentationScore(&allocator), >, 0.0f);
+
+    // Freeing the rest merges everything back to one region
+    for (uint32 i = 0; i < 128; i += 2) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+    StorageReportFull full2 = storageReportFull(&allocator);
+    munit_assert_uint(full2.freeRegions[binTail].count, ==, 0);
+    munit_assert_uint(
+        full2.freeRegions[uintToFloatRoundDown(1024 * 1024)].count, ==, 1);
+    munit_assert_float(fragmentationScore(&allocator), ==, 0.0f);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+typedef struct {
+    uint32 counts[3];
+    OffsetType lastSize;
+} EventLog;
+
+static void logAllocatorEvent(void* userData,
+                              AllocatorEventType type,
+                              OffsetType offset,
+                              OffsetType size,
+                              uint32 binIndex) {
+    EventLog* log = (EventLog*)userData;
+    log->counts[type]++;
+    log->lastSize = size;
+    munit_assert_uint(binIndex, ==, uintToFloatRoundUp(size));
+    if (type == ALLOCATOR_EVENT_FAILURE)
+        munit_assert_uint(offset, ==, NO_SPACE);
+}
+#endif
+
+static MunitResult testInstrumentation() {
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+    Allocator allocator;
+    initAllocator(&allocator, 1024, 16);
+
+    EventLog log = {{0, 0, 0}, 0};
+    setAllocatorEventCallback(&allocator, logAllocatorEvent, &log);
+
+    Allocation a = allocate(&allocator, 256);
+    Allocation b = allocate(&allocator, 256);
+    Allocation fail = allocate(&allocator, 1000);
+    munit_assert_uint(fail.offset, ==, NO_SPACE);
+    munit_assert_uint(log.lastSize, ==, 1000);
+
+    freeAllocation(&allocator, a);
+    freeAllocation(&allocator, b);
+
+    const AllocatorStats* stats = allocatorStats(&allocator);
+    munit_assert_uint(stats->allocations, ==, 2);
+    munit_assert_uint(stats->frees, ==, 2);
+    munit_assert_uint(stats->failures, ==, 1);
+    munit_assert_uint(stats->failuresByBin[uintToFloatRoundUp(1000)], ==, 1);
+    munit_assert_uint(stats->splits, ==, 2);
+    munit_assert_uint(stats->merges, ==, 2);  // a + tail, then a + b + tail
+    munit_assert_uint(stats->maxUsedStorage, ==, 512);
+    munit_assert_uint(stats->maxUsedNodes, ==, 3);
+
+    munit_assert_uint(log.counts[ALLOCATOR_EVENT_ALLOCATE], ==, 2);
+    munit_assert_uint(log.counts[ALLOCATOR_EVENT_FREE], ==, 2);
+    munit_assert_uint(log.counts[ALLOCATOR_EVENT_FAILURE], ==, 1);
+
+    // Reset clears the counters but keeps the callback
+    resetAllocator(&allocator);
+    munit_assert_uint(stats->allocations, ==, 0);
+    Allocation c = allocate(&allocator, 16);
+    munit_assert_uint(log.counts[ALLOCATOR_EVENT_ALLOCATE], ==, 3);
+    freeAllocation(&allocator, c);
+
+    terminateAllocator(&allocator);
+    return MUNIT_OK;
+#else
+    return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult testBestFitPolicy() {
+#if MANTISSA_BITS == 3
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, MAX_ALLOCS);
+
+    // Free 100 and 98 sized holes: both in the round down bin of 100 (96)
+    Allocation a = allocate(&allocator, 100);
+    Allocation b = allocate(&allocator, 16);
+    Allocation c = allocate(&allocator, 98);
+    Allocation d = allocate(&allocator, 16);
+    freeAllocation(&allocator, a);
+    freeAllocation(&allocator, c);
+
+    // First fit: the round up bin (104+) is the top end of the heap
+    Allocation first = allocate(&allocator, 99);
+    munit_assert_uint(first.offset, ==, 230);
+    freeAllocation(&allocator, first);
+
+    // Best fit: the 100 hole fits, the 98 hole is skipped
+    setAllocatorPolicy(&allocator, ALLOCATOR_POLICY_BEST_FIT);
+    Allocation best = allocate(&allocator, 99);
+    munit_assert_uint(best.offset, ==, 0);
+
+    // The reminder (1) goes back to the bins
+    Allocation one = allocate(&allocator, 1);
+    munit_assert_uint(one.offset, ==, 99);
+
+    // Exact bin sizes use the normal search: the 98 hole fits 96
+    Allocation exact = allocate(&allocator, 96);
+    munit_assert_uint(exact.offset, ==, 116);
+
+    freeAllocation(&allocator, best);
+    freeAllocation(&allocator, one);
+    freeAllocation(&allocator, exact);
+    freeAllocation(&allocator, b);
+    freeAllocation(&allocator, d);
+
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 1024 * 1024);
+    munit_assert_uint(report.largestFreeRegion, ==, 1024 * 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+#else
+    return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult testBinRoundingBounds() {
+    // Any mantissa bit count: round down <= size <= round up, and round up
+    // wastes less than one bin step (size / 2^MANTISSA_BITS)
+    OffsetType size = 1;
+    uint64 state = 12345;
+    for (uint32 i = 0; i < 100000; i++) {
+        OffsetType down = floatToUint(uintToFloatRoundDown(size));
+        OffsetType up = floatToUint(uintToFloatRoundUp(size));
+        munit_assert_uint64(down, <=, size);
+        munit_assert_uint64(up, >=, size);
+        munit_assert_uint64((uint64)(up - size) << MANTISSA_BITS, <=, size);
+        munit_assert_uint(uintToFloatRoundUp(size) - uintToFloatRoundDown(size),
+                          <=, 1);
+
+        // Log uniform sizes up to 2^31
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint32 bits = (uint32)(state >> 59) % 31;
+        size = (OffsetType)((state >> 16) & ((1ull << (bits + 1)) - 1)) + 1;
+    }
+
+    // Allocator: the worst case size for every bin still fits the heap
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, 16);
+    for (uint32 bin = 1; bin < NUM_LEAF_BINS; bin++) {
+        OffsetType binSize = floatToUint(bin);
+        if (binSize > 1024 * 1024)
+            break;
+        Allocation a = allocate(&allocator, binSize);
+        munit_assert_uint(a.offset, ==, 0);
+        munit_assert_uint(allocationSize(&allocator, a), ==, binSize);
+        freeAllocation(&allocator, a);
+    }
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testGenerationalHandles() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024, 16);
+
+    Allocation a = allocate(&allocator, 256);
+    munit_assert_true(allocationValid(&allocator, a));
+    Allocation empty = EmptyAllocation;
+    munit_assert_false(allocationValid(&allocator, empty));
+
+#ifdef USE_GENERATIONAL_HANDLES
+    // Same node, new generation: the old handle is stale
+    Allocation stale = a;
+    freeAllocation(&allocator, a);
+    munit_assert_false(allocationValid(&allocator, stale));
+    Allocation b = allocate(&allocator, 128);
+    munit_assert_uint(b.metadata, ==, stale.metadata);
+    munit_assert_false(allocationValid(&allocator, stale));
+    munit_assert_uint(allocationSize(&allocator, stale), ==, 0);
+
+    // Stale and double frees are ignored
+    freeAllocation(&allocator, stale);
+    freeBatch(&allocator, &stale, 1);
+    munit_assert_true(allocationValid(&allocator, b));
+    munit_assert_uint(allocationSize(&allocator, b), ==, 128);
+    munit_assert_uint(reallocate(&allocator, &stale, 64), ==,
+                      REALLOCATE_FAILED);
+
+    // Deferred frees kill the handle right away
+    freeAllocationDeferred(&allocator, b, 1);
+    munit_assert_false(allocationValid(&allocator, b));
+    freeAllocation(&allocator, b);
+    munit_assert_uint(retireUpTo(&allocator, 1), ==, 1);
+
+    // Reset invalidates everything
+    Allocation c = allocate(&allocator, 64);
+    resetAllocator(&allocator);
+    munit_assert_false(allocationValid(&allocator, c));
+    freeAllocation(&allocator, c);
+
+#ifdef USE_ALLOCATOR_INSTRUMENTATION
+    // Counted since the reset
+    munit_assert_uint(allocatorStats(&allocator)->rejectedFrees, ==, 1);
+#endif
+#else
+    freeAllocation(&allocator, a);
+    munit_assert_false(allocationValid(&allocator, a));
+#endif
+
+    StorageReport report = storageReport(&allocator);
+    munit_assert_uint(report.totalFreeSpace, ==, 1024);
+    munit_assert_uint(report.largestFreeRegion, ==, 1024);
+
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testSnapshot() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, 256);
+
+    Allocation allocations[64];
+    for (uint32 i = 0; i < 64; i++) {
+        allocations[i] = allocate(&allocator, 100 + i * 10);
+    }
+    for (uint32 i = 0; i < 64; i += 3) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+
+    uint64 size = allocatorSnapshotSize(&allocator);
+    void* buffer = malloc(size);
+    munit_assert_uint64(saveAllocatorSnapshot(&allocator, buffer, size - 1),
+                        ==, 0);
+    munit_assert_uint64(saveAllocatorSnapshot(&allocator, buffer, size), ==,
+                        size);
+
+    // Truncated or corrupt snapshots are rejected
+    Allocator restored;
+    munit_assert_false(initAllocatorFromSnapshot(&restored, buffer, size - 1));
+    ((uint8*)buffer)[0] ^= 0xff;
+    munit_assert_false(initAllocatorFromSnapshot(&restored, buffer, size));
+    ((uint8*)buffer)[0] ^= 0xff;
+
+    // A header that disagrees with the body: the header of a larger
+    // allocator in front of this one's body, padded to the larger size
+    Allocator larger;
+    initAllocator(&larger, 1024 * 1024, 512);
+    uint64 largerSize = allocatorSnapshotSize(&larger);
+    uint64 headerSize = size - sizeof(Allocator) - (largerSize - size);
+    void* spliced = calloc(1, largerSize);
+    munit_assert_uint64(saveAllocatorSnapshot(&larger, spliced, largerSize),
+                        ==, largerSize);
+    memcpy((uint8*)spliced + headerSize, (uint8*)buffer + headerSize,
+           size - headerSize);
+    memset(&restored, 0xab, sizeof(Allocator));
+    munit_assert_false(
+        initAllocatorFromSnapshot(&restored, spliced, largerSize));
+    munit_assert_uint(((uint8*)&restored)[0], ==, 0xab);
+    munit_assert_uint(((uint8*)&restored)[sizeof(Allocator) - 1], ==, 0xab);
+    free(spliced);
+    terminateAllocator(&larger);
+
+    munit_assert_true(initAllocatorFromSnapshot(&restored, buffer, size));
+    free(buffer);
+
+    // Same layout: both allocators make the same decisions from now on
+    StorageReport report = storageReport(&allocator);
+    StorageReport restoredReport = storageReport(&restored);
+    munit_assert_uint(restoredReport.totalFreeSpace, ==, report.totalFreeSpace);
+    munit_assert_uint(restoredReport.largestFreeRegion, ==,
+                      report.largestFreeRegion);
+    for (uint32 i = 0; i < 16; i++) {
+        Allocation a = allocate(&allocator, 50 + i * 37);
+        Allocation b = allocate(&restored, 50 + i * 37);
+        munit_assert_uint(a.offset, ==, b.offset);
+        munit_assert_uint(a.metadata, ==, b.metadata);
+    }
+
+    // Allocations from before the save can be freed in the restored copy
+    for (uint32 i = 0; i < 64; i++) {
+        if (i % 3 != 0)
+            freeAllocation(&restored, allocations[i]);
+    }
+    resetAllocator(&restored);
+    StorageReport restoredReport2 = storageReport(&restored);
+    munit_assert_uint(restoredReport2.largestFreeRegion, ==, 1024 * 1024);
+
+    terminateAllocator(&restored);
+    terminateAllocator(&allocator);
+
+    return MUNIT_OK;
+}
+
+static MunitResult testUserStorage() {
+    uint64 bytes = requiredMetadataBytes(256);
+    munit_assert_uint64(bytes, >=, 256 * sizeof(NodeIndex));
+    munit_assert_uint64(bytes, <=, ALLOCATOR_METADATA_BYTES(256));
+    uint64* storage = (uint64*)malloc(bytes);
+    memset(storage, 0xcd, bytes);  // Garbage: nothing may depend on it
+
+    Allocator allocator;
+    initAllocatorWithStorage(&allocator, 1024 * 1024, 256, storage, bytes);
+    void* nodes = allocator.m_nodes;
+    munit_assert_ptr_equal(allocator.m_metadata, storage);
+
+    for (uint32 level = 0; level < 4; level++) {
+        Allocation a = allocate(&allocator, 1337);
+        munit_assert_uint(a.offset, ==, 0);
+        Allocation b = allocate(&allocator, 123);
+        munit_assert_uint(b.offset, ==, 1337);
+        freeAllocation(&allocator, a);
+
+        // Reset reuses the same metadata, no reallocation
+        resetAllocator(&allocator);
+        munit_assert_ptr_equal(allocator.m_nodes, nodes);
+        munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                          1024 * 1024);
+    }
+
+    // Caller provided nodes can't grow, the range still can
+    munit_assert_false(growAllocator(&allocator, 2 * 1024 * 1024, 512));
+    munit_assert_true(growAllocator(&allocator, 2 * 1024 * 1024, 256));
+    Allocation big = allocate(&allocator, 2 * 1024 * 1024);
+    munit_assert_uint(big.offset, ==, 0);
+
+    // Terminate leaves the storage to the caller
+    terminateAllocator(&allocator);
+    free(storage);
+    return MUNIT_OK;
+}
+
+static MunitResult testLazyFreelist() {
+    uint64 bytes = requiredMetadataBytes(64);
+    uint64* storage = (uint64*)malloc(bytes);
+    memset(storage, 0xcd, bytes);
+
+    Allocator allocator;
+    initAllocatorWithStorage(&allocator, 1024 * 1024, 64, storage, bytes);
+
+    // Never used nodes are handed out lowest index first
+    Allocation a = allocate(&allocator, 1024);
+    Allocation b = allocate(&allocator, 1024);
+    Allocation c = allocate(&allocator, 1024);
+    munit_assert_uint(a.metadata, ==, 0);
+    munit_assert_uint(b.metadata, ==, 1);
+    munit_assert_uint(c.metadata, ==, 2);
+
+    // Recycled nodes are reused before the untouched ones
+    freeAllocation(&allocator, b);
+    Allocation d = allocate(&allocator, 1024);
+    munit_assert_uint(d.offset, ==, 1024);
+
+    // Nodes not handed out since the reset are rejected
+    resetAllocator(&allocator);
+    munit_assert_false(allocationValid(&allocator, c));
+    Allocation e = allocate(&allocator, 1024);
+    munit_assert_uint(e.metadata, ==, 0);
+
+    // All nodes are still reachable: 64 - 1 reserved - 1 for the remainder
+    Allocation allocations[61];
+    for (uint32 i = 0; i < 61; i++) {
+        allocations[i] = allocate(&allocator, 16);
+        munit_assert_uint(allocations[i].offset, !=, NO_SPACE);
+    }
+    munit_assert_uint(allocate(&allocator, 16).offset, ==, NO_SPACE);
+    for (uint32 i = 0; i < 61; i += 2) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+    freeAllocation(&allocator, e);
+    for (uint32 i = 1; i < 61; i += 2) {
+        freeAllocation(&allocator, allocations[i]);
+    }
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      1024 * 1024);
+
+    terminateAllocator(&allocator);
+    free(storage);
+    return MUNIT_OK;
+}
+
+static MunitResult testLinearAllocator() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, 256);
+
+    // Linear: carved on first use, returned on reset
+    LinearAllocator linear;
+    initLinearAllocator(&linear, &allocator, 64 * 1024);
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      1024 * 1024);
+
+    OffsetType a = linearAllocate(&linear, 100, 1);
+    OffsetType b = linearAllocate(&linear, 100, 256);
+    munit_assert_uint(a, ==, 0);
+    munit_assert_uint(b, ==, 256);
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      1024 * 1024 - 64 * 1024);
+    munit_assert_uint(linearStorageReport(&linear).totalFreeSpace, ==,
+                      64 * 1024 - 356);
+    munit_assert_uint(linearAllocate(&linear, 64 * 1024, 1), ==, NO_SPACE);
+
+    resetLinearAllocator(&linear);
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      1024 * 1024);
+
+    // Ring: released in order by marker
+    RingAllocator ring;
+    munit_assert_true(initRingAllocator(&ring, &allocator, 1000));
+    OffsetType base = ring.m_block.offset;
+
+    munit_assert_uint(ringAllocate(&ring, 400, 1), ==, base);
+    uint64 frame0 = ringAllocatorMarker(&ring);
+    munit_assert_uint(ringAllocate(&ring, 400, 1), ==, base + 400);
+    uint64 frame1 = ringAllocatorMarker(&ring);
+
+    // Doesn't fit at the end, start is still in use
+    munit_assert_uint(ringAllocate(&ring, 300, 1), ==, NO_SPACE);
+
+    // Wraps once frame 0 is released, skipping the last 200
+    releaseRingAllocator(&ring, frame0);
+    munit_assert_uint(ringAllocate(&ring, 300, 1), ==, base);
+    munit_assert_uint(ringStorageReport(&ring).totalFreeSpace, ==, 100);
+    munit_assert_uint(ringAllocate(&ring, 101, 1), ==, NO_SPACE);
+    munit_assert_uint(ringAllocate(&ring, 100, 1), ==, base + 300);
+
+    // The skipped end is released with the data allocated after the wrap
+    releaseRingAllocator(&ring, frame1);
+    munit_assert_uint(ringStorageReport(&ring).totalFreeSpace, ==, 400);
+    munit_assert_uint(ringStorageReport(&ring).largestFreeRegion, ==, 400);
+    releaseRingAllocator(&ring, ringAllocatorMarker(&ring));
+    munit_assert_uint(ringStorageReport(&ring).totalFreeSpace, ==, 1000);
+
+    terminateRingAllocator(&ring);
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      1024 * 1024);
+
+    terminateAllocator(&allocator);
+    return MUNIT_OK;
+}
+
+static MunitResult testSlabAllocator() {
+    Allocator allocator;
+    initAllocator(&allocator, 16 * 1024 * 1024, 256);
+
+    SlabAllocator slab;
+    initSlabAllocator(&slab, &allocator, 16);
+
+    munit_assert_uint(slabSlotSize(1), ==, 16);
+    munit_assert_uint(slabSlotSize(17), ==, 32);
+    munit_assert_uint(slabSlotSize(256), ==, 256);
+    munit_assert_uint(slabSlotSize(257), ==, 0);
+    munit_assert_uint(slabAllocate(&slab, 257).offset, ==, NO_SPACE);
+
+    // One chunk of 1024 slots, served in order
+    SlabAllocation a = slabAllocate(&slab, 30);
+    SlabAllocation b = slabAllocate(&slab, 32);
+    munit_assert_uint(a.offset, ==, 0);
+    munit_assert_uint(b.offset, ==, 32);
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      16 * 1024 * 1024 - 32 * SLAB_SLOTS_PER_CHUNK);
+
+    // Freed slots are reused lowest first
+    slabFree(&slab, a);
+    SlabAllocation c = slabAllocate(&slab, 20);
+    munit_assert_uint(c.offset, ==, 0);
+
+    // Filling the chunk moves on to a second one
+    SlabAllocation slots[SLAB_SLOTS_PER_CHUNK];
+    for (uint32 i = 0; i < SLAB_SLOTS_PER_CHUNK; i++) {
+        slots[i] = slabAllocate(&slab, 32);
+        munit_assert_uint(slots[i].offset, !=, NO_SPACE);
+    }
+    munit_assert_uint(slots[SLAB_SLOTS_PER_CHUNK - 3].metadata, ==,
+                      a.metadata);
+    munit_assert_uint(slots[SLAB_SLOTS_PER_CHUNK - 2].metadata, !=,
+                      a.metadata);
+
+    // One empty chunk per class is kept, the next one returns to the parent
+    slabFree(&slab, b);
+    slabFree(&slab, c);
+    for (uint32 i = 0; i < SLAB_SLOTS_PER_CHUNK; i++) {
+        slabFree(&slab, slots[i]);
+    }
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      16 * 1024 * 1024 - 32 * SLAB_SLOTS_PER_CHUNK);
+
+    // Churning one object reuses the kept chunk, the parent isn't touched
+    for (uint32 i = 0; i < 4; i++) {
+        SlabAllocation d = slabAllocate(&slab, 32);
+        munit_assert_uint(d.offset, ==, 0);
+        munit_assert_uint(d.metadata, ==, a.metadata);
+        slabFree(&slab, d);
+        munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                          16 * 1024 * 1024 - 32 * SLAB_SLOTS_PER_CHUNK);
+    }
+
+    // Terminate releases chunks still in use
+    slabAllocate(&slab, 200);
+    terminateSlabAllocator(&slab);
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==,
+                      16 * 1024 * 1024);
+
+    terminateAllocator(&allocator);
+    return MUNIT_OK;
+}
+
+typedef struct {
+    uint32 created;
+    uint32 destroyed;
+} HeapBlockEvents;
+
+static bool countHeapBlocks(void* userData,
+                            uint32 pool,
+                            uint32 block,
+                            OffsetType size,
+                            bool create) {
+    (void)pool;
+    (void)block;
+    (void)size;
+    HeapBlockEvents* events = (HeapBlockEvents*)userData;
+    if (create)
+        events->created++;
+    else
+        events->destroyed++;
+    return true;
+}
+
+static MunitResult testHeapManager() {
+    HeapBlockEvents events = {0, 0};
+    HeapManager manager;
+    initHeapManager(&manager, countHeapBlocks, &events);
+    uint32 pool = addHeapPool(&manager, 1024 * 1024, 256, 4);
+
+    // Too large for a block
+    munit_assert_uint(heapAllocate(&manager, pool, 2 * 1024 * 1024)
+                          .allocation.offset,
+                      ==, NO_SPACE);
+    munit_assert_uint(events.created, ==, 0);
+
+    // Fill the first block, the next allocation needs a new one
+    HeapAllocation a = heapAllocate(&manager, pool, 768 * 1024);
+    HeapAllocation b = heapAllocate(&manager, pool, 512 * 1024);
+    munit_assert_uint(a.block, ==, 0);
+    munit_assert_uint(b.block, ==, 1);
+    munit_assert_uint(heapPoolBlockCount(&manager, pool), ==, 2);
+
+    // Small allocations go to the block with the smallest fitting region
+    HeapAllocation c = heapAllocate(&manager, pool, 200 * 1024);
+    munit_assert_uint(c.block, ==, 0);
+    HeapAllocation d = heapAllocate(&manager, pool, 300 * 1024);
+    munit_assert_uint(d.block, ==, 1);
+
+    // All blocks too full: block 2
+    HeapAllocation e = heapAllocate(&manager, pool, 256 * 1024);
+    munit_assert_uint(e.block, ==, 2);
+    munit_assert_uint(events.created, ==, 3);
+
+    // One empty block is kept, the second is destroyed
+    heapFree(&manager, e);
+    munit_assert_uint(heapPoolBlockCount(&manager, pool), ==, 3);
+    heapFree(&manager, b);
+    heapFree(&manager, d);
+    munit_assert_uint(heapPoolBlockCount(&manager, pool), ==, 2);
+    munit_assert_uint(events.destroyed, ==, 1);
+
+    // The kept empty block is reused without a create
+    HeapAllocation f = heapAllocate(&manager, pool, 1024 * 1024);
+    munit_assert_uint(f.allocation.offset, ==, 0);
+    munit_assert_uint(events.created, ==, 3);
+
+    StorageReport report = heapPoolStorageReport(&manager, pool);
+    munit_assert_uint(report.totalFreeSpace, ==, 1024 * 1024 - 968 * 1024);
+
+    heapFree(&manager, a);
+    heapFree(&manager, c);
+    heapFree(&manager, f);
+    terminateHeapManager(&manager);
+    munit_assert_uint(events.created, ==, events.destroyed);
+    return MUNIT_OK;
+}
+
+static MunitResult testHeapManagerBinOverflow() {
+    HeapBlockEvents events = {0, 0};
+    HeapManager manager;
+    initHeapManager(&manager, countHeapBlocks, &events);
+    uint32 pool = addHeapPool(&manager, 1000, 16, 4);
+
+    // Fits the block size but rounds up past the bin of a whole block
+    munit_assert_uint(uintToFloatRoundUp(999), >, uintToFloatRoundDown(1000));
+    for (uint32 i = 0; i < 5; i++) {
+        munit_assert_uint(heapAllocate(&manager, pool, 999).allocation.offset,
+                          ==, NO_SPACE);
+    }
+    munit_assert_uint(heapPoolBlockCount(&manager, pool), ==, 0);
+    munit_assert_uint(events.created, ==, 0);
+
+    terminateHeapManager(&manager);
+    return MUNIT_OK;
+}
+
+static MunitResult testBinIndexBatch() {
+    // Odd count: covers the vector body and the scalar tail
+    enum { COUNT = 1001 };
+    OffsetType sizes[COUNT];
+    uint32 binIndices[COUNT];
+    for (uint32 i = 0; i < COUNT; i++) {
+        if (i < 64) {
+            sizes[i] = i;  // Denorms and the first exponents
+        } else if (i < 96) {
+            sizes[i] = (OffsetType)1 << (i - 64);  // Powers of two
+        } else if (i < 128) {
+            sizes[i] = ((OffsetType)1 << (i - 96)) + 1;  // Just above
+        } else {
+            sizes[i] = (OffsetType)munit_rand_uint32();
+        }
+    }
+    sizes[COUNT - 1] = (OffsetType)0xffffffff;
+
+    uintToFloatRoundUpBatch(sizes, binIndices, COUNT);
+    for (uint32 i = 0; i < COUNT; i++) {
+        munit_assert_uint(binIndices[i], ==, uintToFloatRoundUp(sizes[i]));
+    }
+    return MUNIT_OK;
+}
+
+static MunitResult testRangeIterator() {
+    Allocator allocator;
+    initAllocator(&allocator, 1000, 64);
+
+    Allocation a = allocate(&allocator, 100);
+    Allocation b = allocate(&allocator, 200);
+    Allocation c = allocate(&allocator, 300);
+    freeAllocation(&allocator, b);
+
+    // [0,100) used, [100,300) free, [300,600) used, [600,1000) free
+    OffsetType expectedOffsets[] = {0, 100, 300, 600};
+    OffsetType expectedSizes[] = {100, 200, 300, 400};
+    bool expectedUsed[] = {true, false, true, false};
+
+    AllocatorRangeIterator iterator;
+    initRangeIterator(&iterator, &allocator);
+    AllocatorRange range;
+    uint32 count = 0;
+    while (nextRange(&iterator, &allocator, &range)) {
+        munit_assert_uint(count, <, 4);
+        munit_assert_uint(range.offset, ==, expectedOffsets[count]);
+        munit_assert_uint(range.size, ==, expectedSizes[count]);
+        munit_assert(range.used == expectedUsed[count]);
+        count++;
+    }
+    munit_assert_uint(count, ==, 4);
+
+    // Starting from a handle
+    initRangeIteratorAt(&iterator, &allocator, c);
+    munit_assert_true(nextRange(&iterator, &allocator, &range));
+    munit_assert_uint(range.offset, ==, 300);
+    munit_assert_uint(range.metadata, ==, c.metadata);
+
+    munit_assert_uint(freeSpaceInRange(&allocator, a, 1000), ==, 600);
+    munit_assert_uint(freeSpaceInRange(&allocator, a, 250), ==, 150);
+    munit_assert_uint(freeSpaceInRange(&allocator, a, 100), ==, 0);
+    munit_assert_uint(freeSpaceInRange(&allocator, c, 700), ==, 100);
+
+    // Freed handles don't start a walk
+    freeAllocation(&allocator, a);
+    initRangeIteratorAt(&iterator, &allocator, a);
+    munit_assert_false(nextRange(&iterator, &allocator, &range));
+
+    freeAllocation(&allocator, c);
+    terminateAllocator(&allocator);
+    return MUNIT_OK;
+}
+
+static MunitResult testAllocatorTrace() {
+#ifdef USE_ALLOCATOR_TRACE
+    const char* path = "offsetAllocatorTests.trace";
+    munit_assert_true(startAllocatorTrace(path));
+    munit_assert_false(startAllocatorTrace(path));
+
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, 64);
+    traceAllocator(&allocator, 7);
+
+    Allocation a = allocate(&allocator, 100);
+    Allocation b = allocateAligned(&allocator, 256, 64);
+    Allocation failed = allocate(&allocator, 2 * 1024 * 1024);
+    munit_assert_uint(failed.offset, ==, NO_SPACE);
+    munit_assert_int(reallocate(&allocator, &b, 128), ==, REALLOCATE_IN_PLACE);
+    uint32 oldA = a.metadata;
+    munit_assert_int(reallocate(&allocator, &a, 4096), ==, REALLOCATE_MOVED);
+    freeAllocation(&allocator, a);
+    resetAllocator(&allocator);
+    munit_assert_true(growAllocator(&allocator, 2 * 1024 * 1024, 128));
+
+    // Untraced allocators record nothing
+    Allocator untraced;
+    initAllocator(&untraced, 1024, 16);
+    Allocation c = allocate(&untraced, 16);
+    freeAllocation(&untraced, c);
+    terminateAllocator(&untraced);
+
+    stopAllocatorTrace();
+    terminateAllocator(&allocator);
+
+    FILE* file = fopen(path, "rb");
+    munit_assert_not_null(file);
+    uint8 bytes[1024];
+    uint64 size = fread(bytes, 1, sizeof(bytes), file);
+    fclose(file);
+    remove(path);
+
+    TraceEvent events[16];
+    munit_assert_uint64(decodeAllocatorTrace(bytes, size, NULL, 0), ==, 9);
+    munit_assert_uint64(decodeAllocatorTrace(bytes, size, events, 16), ==, 9);
+    for (uint32 i = 0; i < 9; i++) {
+        munit_assert_uint32(events[i].allocatorId, ==, 7);
+        munit_assert_uint64(events[i].sequence, ==, i);
+    }
+
+    munit_assert_int(events[0].type, ==, TRACE_EVENT_INIT);
+    munit_assert_uint64(events[0].size, ==, 1024 * 1024);
+    munit_assert_uint32(events[0].maxAllocs, ==, 64);
+
+    munit_assert_int(events[1].type, ==, TRACE_EVENT_ALLOCATE);
+    munit_assert_uint64(events[1].size, ==, 100);
+    munit_assert_uint64(events[1].alignment, ==, 1);
+    munit_assert_uint32(events[1].metadata, ==, oldA);
+
+    munit_assert_int(events[2].type, ==, TRACE_EVENT_ALLOCATE);
+    munit_assert_uint64(events[2].alignment, ==, 64);
+    munit_assert_uint32(events[2].metadata, ==, b.metadata);
+
+    munit_assert_int(events[3].type, ==, TRACE_EVENT_ALLOCATE);
+    munit_assert_uint32(events[3].metadata, ==, TRACE_NO_METADATA);
+
+    // Moves are one event too, not an allocate and a free
+    munit_assert_int(events[4].type, ==, TRACE_EVENT_REALLOCATE);
+    munit_assert_uint32(events[4].metadata, ==, b.metadata);
+    munit_assert_uint32(events[4].newMetadata, ==, b.metadata);
+    munit_assert_uint64(events[4].size, ==, 128);
+
+    munit_assert_int(events[5].type, ==, TRACE_EVENT_REALLOCATE);
+    munit_assert_uint32(events[5].metadata, ==, oldA);
+    munit_assert_uint32(events[5].newMetadata, ==, a.metadata);
+    munit_assert_uint64(events[5].size, ==, 4096);
+
+    munit_assert_int(events[6].type, ==, TRACE_EVENT_FREE);
+    munit_assert_uint32(events[6].metadata, ==, a.metadata);
+
+    munit_assert_int(events[7].type, ==, TRACE_EVENT_RESET);
+    munit_assert_int(events[8].type, ==, TRACE_EVENT_GROW);
+    munit_assert_uint64(events[8].size, ==, 2 * 1024 * 1024);
+    munit_assert_uint32(events[8].maxAllocs, ==, 128);
+
+    // A truncated file keeps whole chunks only, a bad header nothing
+    munit_assert_uint64(decodeAllocatorTrace(bytes, size - 1, NULL, 0), ==, 0);
+    bytes[0] ^= 0xff;
+    munit_assert_uint64(decodeAllocatorTrace(bytes, size, NULL, 0), ==, 0);
+
+    return MUNIT_OK;
+#else
+    return MUNIT_SKIP;
+#endif
+}
+
+static uint32 countFreeRanges(const Allocator* allocator) {
+    AllocatorRangeIterator iterator;
+    AllocatorRange range;
+    uint32 count = 0;
+    initRangeIterator(&iterator, allocator);
+    while (nextRange(&iterator, allocator, &range)) {
+        if (!range.used)
+            count++;
+    }
+    return count;
+}
+
+static MunitResult testLifetimeHint() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024, 16);
+
+    // Long lived from the start, transient from the end of the free node
+    Allocation a = allocateWithHint(&allocator, 100, ALLOCATION_LIFETIME_LONG);
+    Allocation t =
+        allocateWithHint(&allocator, 100, ALLOCATION_LIFETIME_TRANSIENT);
+    Allocation b = allocateWithHint(&allocator, 100, ALLOCATION_LIFETIME_LONG);
+    Allocation u =
+        allocateWithHint(&allocator, 100, ALLOCATION_LIFETIME_TRANSIENT);
+    munit_assert_uint(a.offset, ==, 0);
+    munit_assert_uint(t.offset, ==, 924);
+    munit_assert_uint(b.offset, ==, 100);
+    munit_assert_uint(u.offset, ==, 824);
+    munit_assert_uint(freeSpaceInRange(&allocator, b, 824), ==, 624);
+
+    // Freeing the transients merges back into one free range
+    freeAllocation(&allocator, u);
+    freeAllocation(&allocator, t);
+    munit_assert_uint32(countFreeRanges(&allocator), ==, 1);
+    munit_assert_uint(freeSpaceInRange(&allocator, b, 1024), ==, 824);
+
+    // Exact fit: no split either way
+    freeAllocation(&allocator, b);
+    freeAllocation(&allocator, a);
+    Allocation full =
+        allocateWithHint(&allocator, 1024, ALLOCATION_LIFETIME_TRANSIENT);
+    munit_assert_uint(full.offset, ==, 0);
+    munit_assert_uint(storageReport(&allocator).totalFreeSpace, ==, 0);
+    freeAllocation(&allocator, full);
+
+    // Interleaved frames: freed transients leave a single hole with hints,
+    // one hole per transient without
+    const uint32 frames = 8;
+    for (uint32 hinted = 0; hinted < 2; hinted++) {
+        Allocator heap;
+        initAllocator(&heap, 1024 * 1024, 64);
+        Allocation transients[8];
+        for (uint32 i = 0; i < frames; i++) {
+            allocate(&heap, 4096);
+            transients[i] = allocateWithHint(
+                &heap, 1000 + i,
+                hinted ? ALLOCATION_LIFETIME_TRANSIENT
+                       : ALLOCATION_LIFETIME_LONG);
+        }
+        for (uint32 i = 0; i < frames; i++) {
+            freeAllocation(&heap, transients[i]);
+        }
+        munit_assert_uint32(countFreeRanges(&heap), ==, hinted ? 1 : frames);
+        terminateAllocator(&heap);
+    }
+
+    terminateAllocator(&allocator);
+    return MUNIT_OK;
+}
+
+static MunitResult testValidateAllocator() {
+    Allocator allocator;
+    initAllocator(&allocator, 1024 * 1024, 256);
+    munit_assert_int(validateAllocator(&allocator, NULL), ==, ALLOCATOR_VALID);
+
+    // Mixed workload: valid after every operation, full and incremental
+    AllocatorValidator validator;
+    initAllocatorValidator(&validator);
+    Allocation allocations[64];
+    for (uint32 i = 0; i < 64; i++) {
+        allocations[i] = (i % 3) ? allocate(&allocator, 100 + i * 37)
+                                 : allocateWithHint(
+                                       &allocator, 1000 + i,
+                                       ALLOCATION_LIFETIME_TRANSIENT);
+    }
+    for (uint32 i = 0; i < 64; i++) {
+        uint32 index = (i * 23) % 64;
+        freeAllocation(&allocator, allocations[index]);
+        munit_assert_int(validateAllocator(&allocator, NULL), ==,
+                         ALLOCATOR_VALID);
+        munit_assert_int(validateAllocatorStep(&allocator, &validator, 4, NULL),
+                         ==, ALLOCATOR_VALID);
+        if (i % 2)
+            allocations[index] = allocate(&allocator, 64 + i);
+    }
+    munit_assert_uint64(validator.m_passes, >, 0);
+
+    // One step per 2 nodes: 4 allocations + the free tail = 3 steps a pass
+    resetAllocator(&allocator);
+    for (uint32 i = 0; i < 4; i++) {
+        allocations[i] = allocate(&allocator, 1000);
+    }
+    initAllocatorValidator(&validator);
+    for (uint32 i = 0; i < 6; i++) {
+        munit_assert_int(validateAllocatorStep(&allocator, &validator, 2, NULL),
+                         ==, ALLOCATOR_VALID);
+    }
+    munit_assert_uint64(validator.m_passes, ==, 2);
+
+    // The cursor node merged away: restarts the pass instead of failing
+    munit_assert_int(validateAllocatorStep(&allocator, &validator, 2, NULL),
+                     ==, ALLOCATOR_VALID);
+    freeAllocation(&allocator, allocations[1]);
+    freeAllocation(&allocator, allocations[2]);
+    munit_assert_int(validateAllocatorStep(&allocator, &validator, 2, NULL),
+                     ==, ALLOCATOR_VALID);
+    munit_assert_uint64(validator.m_passes, ==, 2);
+    munit_assert_int(validateAllocatorStep(&allocator, &validator, 2, NULL),
+                     ==, ALLOCATOR_VALID);
+    munit_assert_uint64(validator.m_passes, ==, 3);
+
+    // Corruptions
+    uint32 badNode;
+    allocator.m_freeStorage++;
+    munit_assert_int(validateAllocator(&allocator, &badNode), ==,
+                     ALLOCATOR_INVALID_FREE_STORAGE);
+    munit_assert_uint32(badNode, ==, NODE_UNUSED);
+    allocator.m_freeStorage--;
+
+    allocator.m_freeOffset--;
+    munit_assert_int(validateAllocator(&allocator, NULL), ==,
+                     ALLOCATOR_INVALID_NODE_COUNT);
+    allocator.m_freeOffset++;
+
+    uint32 binIndex = uintToFloatRoundDown(2000);
+    allocator.m_binCounts[binIndex]++;
+    munit_assert_int(validateAllocator(&allocator, NULL), ==,
+                     ALLOCATOR_INVALID_FREE_STORAGE);
+    allocator.m_binCounts[binIndex]--;
+
+    // The free range of the two merged allocations (node of the second free)
+    // loses its mask bit
+    LeafBinsMask bit = (LeafBinsMask)1 << (binIndex & LEAF_BINS_INDEX_MASK);
+    allocator.m_usedBins[binIndex >> TOP_BINS_INDEX_SHIFT] ^= bit;
+    munit_assert_int(validateAllocator(&allocator, &badNode), ==,
+                     ALLOCATOR_INVALID_BIN_MASKS);
+    munit_assert_uint32(badNode, ==, allocations[2].metadata);
+    AllocatorValidation result = ALLOCATOR_VALID;
+    for (uint32 i = 0; i < NUM_TOP_BINS && result == ALLOCATOR_VALID; i++) {
+        result = validateAllocatorStep(&allocator, &validator, 1, NULL);
+    }
+    munit_assert_int(result, ==, ALLOCATOR_INVALID_BIN_MASKS);
+    allocator.m_usedBins[binIndex >> TOP_BINS_INDEX_SHIFT] ^= bit;
+
+    NodeIndex head = allocator.m_headNode;
+    allocator.m_headNode = allocations[3].metadata;
+    munit_assert_int(validateAllocator(&allocator, &badNode), ==,
+                     ALLOCATOR_INVALID_NEIGHBOR_LINKS);
+    munit_assert_uint32(badNode, ==, allocations[3].metadata);
+    allocator.m_headNode = head;
+
+    munit_assert_int(validateAllocator(&allocator, NULL), ==, ALLOCATOR_VALID);
+    terminateAllocator(&allocator);
+    return MUNIT_OK;
+}
+
 static MunitTest test_suite_tests[] = {
     {"/test_uint_to_float", testUintToFloat, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
@@ -280,6 +1848,62 @@ static MunitTest test_suite_tests[] = {
      NULL},
     {"/test_offset_reuse_complex_allocator", testOffsetReuseComplexAllocator,
      NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_sharded_allocator", testShardedAllocator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_allocator_magazine", testAllocatorMagazine, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_batch_allocate_free", testBatchAllocateFree, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_max_allocations", testMaxAllocations, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_large_offset_allocator", testLargeOffsetAllocator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_aligned_allocate", testAlignedAllocate, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_reallocate", testReallocate, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_grow_allocator", testGrowAllocator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_remote_free", testRemoteFree, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_deferred_free", testDeferredFree, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_defragment", testDefragment, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_storage_report_counts", testStorageReportCounts, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_instrumentation", testInstrumentation, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_best_fit_policy", testBestFitPolicy, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_bin_rounding_bounds", testBinRoundingBounds, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_generational_handles", testGenerationalHandles, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_snapshot", testSnapshot, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_user_storage", testUserStorage, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_lazy_freelist", testLazyFreelist, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_linear_allocator", testLinearAllocator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_slab_allocator", testSlabAllocator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_heap_manager", testHeapManager, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_heap_manager_bin_overflow", testHeapManagerBinOverflow, NULL,
+     NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_bin_index_batch", testBinIndexBatch, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_range_iterator", testRangeIterator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_allocator_trace", testAllocatorTrace, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_lifetime_hint", testLifetimeHint, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/test_validate_allocator", testValidateAllocator, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     /* Marca el final del array */
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
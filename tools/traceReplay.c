@@ -0,0 +1,302 @@
+// MIT License (see file: LICENSE)
+
+// Replays a binary allocation trace (see allocatorTrace.h) against the
+// allocator, for reproducing field fragmentation and comparing policies or
+// build configurations offline.
+//
+// Build (same configuration macros as the library, the trace recorder
+// itself doesn't need USE_ALLOCATOR_TRACE to decode):
+//   cc -std=c11 -O2 -o traceReplay tools/traceReplay.c *.c
+//
+// Usage:
+//   traceReplay [--best-fit] [--interval N] trace.bin
+//
+// Every traced allocator is replayed into its own allocator, with the events
+// of all threads merged by sequence number. The first pass is timed, the
+// second prints the storage report of every allocator each N events (and at
+// the end). Allocations that failed in the field are replayed too: if they
+// succeed now they are freed right away, so the replay state stays the same.
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "../allocatorTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define REPLAY_MAX_HEAPS 64
+
+static inline uint64 nowNs(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64)(counter.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000ull + (uint64)ts.tv_nsec;
+#endif
+}
+
+typedef struct {
+    uint32 id;
+    uint32 handleCount;
+    Allocation* handles;  // Trace metadata -> replay allocation
+    Allocator allocator;
+} ReplayHeap;
+
+typedef struct {
+    uint64 allocations;
+    uint64 reallocations;
+    uint64 frees;
+    uint64 originalFailures;
+    uint64 replayFailures;  // Succeeded in the field, failed in the replay
+    uint64 replaySuccesses; // Failed in the field, succeeded in the replay
+    uint64 unknownEvents;   // Events of allocators without an INIT
+} ReplayStats;
+
+static bool readFile(const char* path, void** data, uint64* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Can't open trace: %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    *data = length > 0 ? malloc((size_t)length) : NULL;
+    *size = *data ? fread(*data, 1, (size_t)length, file) : 0;
+    fclose(file);
+    return *size > 0;
+}
+
+static int compareSequence(const void* a, const void* b) {
+    uint64 sa = ((const TraceEvent*)a)->sequence;
+    uint64 sb = ((const TraceEvent*)b)->sequence;
+    return sa < sb ? -1 : sa > sb;
+}
+
+static void clearHandles(ReplayHeap* heap, const uint32 first) {
+    Allocation empty = EmptyAllocation;
+    for (uint32 i = first; i < heap->handleCount; i++) {
+        heap->handles[i] = empty;
+    }
+}
+
+static ReplayHeap* findHeap(ReplayHeap* heaps,
+                            const uint32 numHeaps,
+                            const uint32 id) {
+    for (uint32 i = 0; i < numHeaps; i++) {
+        if (heaps[i].id == id)
+            return &heaps[i];
+    }
+    return NULL;
+}
+
+static void printReports(const ReplayHeap* heaps,
+                         const uint32 numHeaps,
+                         const char* label) {
+    for (uint32 i = 0; i < numHeaps; i++) {
+        StorageReport report = storageReport(&heaps[i].allocator);
+        printf("%-8s allocator %-6u totalFree %12llu largestFree %12llu "
+               "frag %.3f\n",
+               label, heaps[i].id, (unsigned long long)report.totalFreeSpace,
+               (unsigned long long)report.largestFreeRegion,
+               fragmentationScore(&heaps[i].allocator));
+    }
+}
+
+static ReplayStats replay(const TraceEvent* events,
+                          const uint64 count,
+                          const bool bestFit,
+                          const uint64 interval) {
+    ReplayStats stats = {0};
+    ReplayHeap heaps[REPLAY_MAX_HEAPS];
+    uint32 numHeaps = 0;
+
+    for (uint64 i = 0; i < count; i++) {
+        const TraceEvent* event = &events[i];
+        ReplayHeap* heap = findHeap(heaps, numHeaps, event->allocatorId);
+
+        if (event->type == TRACE_EVENT_INIT) {
+            if (heap) {
+                terminateAllocator(&heap->allocator);
+                free(heap->handles);
+            } else if (numHeaps < REPLAY_MAX_HEAPS) {
+                heap = &heaps[numHeaps++];
+            } else {
+                stats.unknownEvents++;
+                continue;
+            }
+            heap->id = event->allocatorId;
+            heap->handleCount = event->maxAllocs;
+            heap->handles =
+                (Allocation*)malloc(event->maxAllocs * sizeof(Allocation));
+            clearHandles(heap, 0);
+            initAllocator(&heap->allocator, (OffsetType)event->size,
+                          event->maxAllocs);
+            setAllocatorPolicy(&heap->allocator,
+                               bestFit ? ALLOCATOR_POLICY_BEST_FIT
+                                       : (AllocatorPolicy)event->policy);
+        } else if (!heap) {
+            stats.unknownEvents++;
+        } else if (event->type == TRACE_EVENT_ALLOCATE ||
+                   event->type == TRACE_EVENT_ALLOCATE_TRANSIENT) {
+            OffsetType size = (OffsetType)event->size;
+            Allocation allocation;
+            if (event->type == TRACE_EVENT_ALLOCATE_TRANSIENT) {
+                allocation = allocateWithHint(&heap->allocator, size,
+                                              ALLOCATION_LIFETIME_TRANSIENT);
+            } else if (event->alignment > 1) {
+                allocation = allocateAligned(&heap->allocator, size,
+                                             (OffsetType)event->alignment);
+            } else {
+                allocation = allocate(&heap->allocator, size);
+            }
+            stats.allocations++;
+
+            if (event->metadata == TRACE_NO_METADATA) {
+                stats.originalFailures++;
+                if (allocation.offset != NO_SPACE) {
+                    stats.replaySuccesses++;
+                    freeAllocation(&heap->allocator, allocation);
+                }
+            } else {
+                if (allocation.offset == NO_SPACE)
+                    stats.replayFailures++;
+                if (event->metadata < heap->handleCount)
+                    heap->handles[event->metadata] = allocation;
+            }
+        } else if (event->type == TRACE_EVENT_REALLOCATE) {
+            // Failed in the field: the allocation stayed as it was. Handles
+            // of allocations that failed in the replay are skipped.
+            stats.reallocations++;
+            if (event->newMetadata == TRACE_NO_METADATA) {
+                stats.originalFailures++;
+            } else if (event->metadata < heap->handleCount &&
+                       event->newMetadata < heap->handleCount &&
+                       heap->handles[event->metadata].offset != NO_SPACE) {
+                Allocation allocation = heap->handles[event->metadata];
+                if (reallocate(&heap->allocator, &allocation,
+                               (OffsetType)event->size) == REALLOCATE_FAILED)
+                    stats.replayFailures++;
+                Allocation empty = EmptyAllocation;
+                heap->handles[event->metadata] = empty;
+                heap->handles[event->newMetadata] = allocation;
+            }
+        } else if (event->type == TRACE_EVENT_FREE) {
+            // Frees of allocations that failed in the replay are skipped
+            stats.frees++;
+            if (event->metadata < heap->handleCount &&
+                heap->handles[event->metadata].offset != NO_SPACE) {
+                freeAllocation(&heap->allocator,
+                               heap->handles[event->metadata]);
+                Allocation empty = EmptyAllocation;
+                heap->handles[event->metadata] = empty;
+            }
+        } else if (event->type == TRACE_EVENT_RESET) {
+            resetAllocator(&heap->allocator);
+            clearHandles(heap, 0);
+        } else if (event->type == TRACE_EVENT_GROW) {
+            growAllocator(&heap->allocator, (OffsetType)event->size,
+                          event->maxAllocs);
+            if (event->maxAllocs > heap->handleCount) {
+                uint32 first = heap->handleCount;
+                heap->handles = (Allocation*)realloc(
+                    heap->handles, event->maxAllocs * sizeof(Allocation));
+                heap->handleCount = event->maxAllocs;
+                clearHandles(heap, first);
+            }
+        }
+
+        if (interval && (i + 1) % interval == 0) {
+            char label[32];
+            snprintf(label, sizeof(label), "%llu", (unsigned long long)(i + 1));
+            printReports(heaps, numHeaps, label);
+        }
+    }
+
+    if (interval)
+        printReports(heaps, numHeaps, "final");
+    for (uint32 i = 0; i < numHeaps; i++) {
+        terminateAllocator(&heaps[i].allocator);
+        free(heaps[i].handles);
+    }
+    return stats;
+}
+
+int main(int argc, char* argv[]) {
+    const char* tracePath = NULL;
+    bool bestFit = false;
+    uint64 interval = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--best-fit")) {
+            bestFit = true;
+        } else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+            interval = strtoull(argv[++i], NULL, 10);
+        } else if (argv[i][0] != '-' && !tracePath) {
+            tracePath = argv[i];
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (!tracePath) {
+        fprintf(stderr,
+                "Usage: traceReplay [--best-fit] [--interval N] trace.bin\n");
+        return 2;
+    }
+
+    void* data;
+    uint64 size;
+    if (!readFile(tracePath, &data, &size))
+        return 1;
+
+    uint64 count = decodeAllocatorTrace(data, size, NULL, 0);
+    if (count == 0) {
+        fprintf(stderr, "No events in trace: %s\n", tracePath);
+        free(data);
+        return 1;
+    }
+    TraceEvent* events = (TraceEvent*)malloc(count * sizeof(TraceEvent));
+    count = decodeAllocatorTrace(data, size, events, count);
+    free(data);
+    qsort(events, count, sizeof(TraceEvent), compareSequence);
+
+    uint64 start = nowNs();
+    ReplayStats stats = replay(events, count, bestFit, 0);
+    double ns = (double)(nowNs() - start) / count;
+
+    printf("Events %llu, allocations %llu, reallocations %llu, frees %llu, "
+           "%.2f ns/event\n",
+           (unsigned long long)count, (unsigned long long)stats.allocations,
+           (unsigned long long)stats.reallocations,
+           (unsigned long long)stats.frees, ns);
+    printf("Failures: %llu in the trace, %llu new in the replay, %llu "
+           "recovered\n",
+           (unsigned long long)stats.originalFailures,
+           (unsigned long long)stats.replayFailures,
+           (unsigned long long)stats.replaySuccesses);
+    if (stats.unknownEvents) {
+        printf("Skipped %llu events of allocators without an init event\n",
+               (unsigned long long)stats.unknownEvents);
+    }
+
+    if (interval)
+        replay(events, count, bestFit, interval);
+
+    free(events);
+    return 0;
+}